@@ -55,6 +55,9 @@ int main()
 {
     grrlib_init();
     ctoy_begin();
+#if ROCKET_BAKE_SAMPLES_PER_ROW > 0
+    rocket_bake_tracks(ROCKET_BAKE_SAMPLES_PER_ROW, ROCKET_BAKE_MAX_ERROR);
+#endif
 
     // Wait loop for recording
     /*
@@ -97,6 +100,7 @@ int main()
 
         // Do rocket udpdate
         set_rocket_track_seconds(elapsedTimeS);
+        rocket_evaluate_frame(get_rocket_track_row());
 
         ctoy_main_loop();
 
@@ -0,0 +1,56 @@
+#ifndef SYNC_BUNDLE_H
+#define SYNC_BUNDLE_H
+
+/* Packed binary bundle holding the keys of all tracks.
+ *
+ * Layout, every section starts at a SYNC_BUNDLE_ALIGN boundary:
+ *   struct sync_bundle_header
+ *   struct sync_bundle_track[num_tracks]
+ *   int32_t rows[num_keys]
+ *   float values[num_keys]
+ *   uint8_t types[num_keys]
+ *   char names[] (NUL terminated)
+ *
+ * The keys of one track are the range [first_key, first_key + num_keys)
+ * in the key arrays. All 32-bit fields are stored in the byte order of
+ * the target, the magic tells the loader if it has to swap.
+ */
+
+#include "base.h"
+
+#define SYNC_BUNDLE_MAGIC 0x524B5442 /* "RKTB" */
+#define SYNC_BUNDLE_VERSION 1
+#define SYNC_BUNDLE_ALIGN 32
+#define SYNC_BUNDLE_EXT ".rktb"
+
+struct sync_bundle_header {
+	uint32_t magic;
+	uint32_t version;
+	uint32_t size; /* whole file in bytes */
+	uint32_t num_tracks;
+	uint32_t num_keys;
+	uint32_t rows_offset;
+	uint32_t values_offset;
+	uint32_t types_offset;
+	uint32_t names_offset;
+	uint32_t reserved[7];
+};
+
+struct sync_bundle_track {
+	uint32_t name_offset; /* from names_offset */
+	uint32_t first_key;
+	uint32_t num_keys;
+	uint32_t reserved;
+};
+
+static inline uint32_t sync_bundle_align(uint32_t offset)
+{
+	return (offset + SYNC_BUNDLE_ALIGN - 1) & ~(uint32_t)(SYNC_BUNDLE_ALIGN - 1);
+}
+
+static inline uint32_t sync_bundle_swap32(uint32_t v)
+{
+	return (v >> 24) | ((v >> 8) & 0xFF00) | ((v << 8) & 0xFF0000) | (v << 24);
+}
+
+#endif /* SYNC_BUNDLE_H */
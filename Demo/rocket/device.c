@@ -1,5 +1,6 @@
 #include "device.h"
 #include "track.h"
+#include "bundle.h"
 #include <assert.h>
 #include <ctype.h>
 #include <math.h>
@@ -8,6 +9,10 @@
 
 #include <sys/stat.h>
 
+#ifdef GEKKO
+ #include <ogc/lwp_watchdog.h>
+#endif
+
 #ifdef WIN32
  #include <direct.h>
  #define S_ISDIR(m) (((m)& S_IFMT) == S_IFDIR)
@@ -15,12 +20,28 @@
 #endif
 
 void sync_tcp_device_dtor(void); /* not worth adding a tcp.h for */
+#ifdef SYNC_PLAYER
+static int load_bundle(struct sync_device *d, const char *path);
+static const char *sync_bundle_path(const char *base);
+#endif
+
+/* FNV-1a */
+static uint32_t track_name_hash(const char *name)
+{
+	uint32_t hash = 2166136261u;
+	while (*name) {
+		hash ^= (unsigned char)*name++;
+		hash *= 16777619u;
+	}
+	return hash;
+}
 
 static int find_track(struct sync_device *d, const char *name)
 {
 	int i;
+	uint32_t hash = track_name_hash(name);
 	for (i = 0; i < (int)d->num_tracks; ++i)
-		if (!strcmp(name, d->tracks[i]->name))
+		if (d->track_hashes[i] == hash && !strcmp(name, d->tracks[i]->name))
 			return i;
 	return -1; /* not found */
 }
@@ -102,14 +123,52 @@ static inline int sockio_send(struct sync_device *d, const void *buf, int len)
 	return d->sockio_cb.send(d->sockio_ctxt, buf, len) != len;
 }
 
+/* Receive all len bytes, recv may return a part of them */
 static inline int sockio_recv(struct sync_device *d, void *buf, int len)
 {
+	char *pos = buf;
 	assert(len > 0);
-	return d->sockio_cb.recv(d->sockio_ctxt, buf, len) != len;
+	while (len > 0) {
+		int n = d->sockio_cb.recv(d->sockio_ctxt, pos, len);
+		if (n <= 0)
+			return -1;
+		pos += n;
+		len -= n;
+	}
+	return 0;
+}
+
+#ifdef SYNC_EDITOR_THREAD
+#ifdef GEKKO
+static int thread_start(sync_thread_t *thread, void *(*fn)(void *), void *arg)
+{
+	return LWP_CreateThread(thread, fn, arg, NULL, 0, 64) < 0 ? -1 : 0;
+}
+#define thread_join(thread) LWP_JoinThread(thread, NULL)
+#define mutex_init(mutex) LWP_MutexInit(mutex, false)
+#define mutex_destroy(mutex) LWP_MutexDestroy(*(mutex))
+#define mutex_lock(mutex) LWP_MutexLock(*(mutex))
+#define mutex_unlock(mutex) LWP_MutexUnlock(*(mutex))
+#else
+static int thread_start(sync_thread_t *thread, void *(*fn)(void *), void *arg)
+{
+	return pthread_create(thread, NULL, fn, arg) ? -1 : 0;
 }
+#define thread_join(thread) pthread_join(thread, NULL)
+#define mutex_init(mutex) pthread_mutex_init(mutex, NULL)
+#define mutex_destroy(mutex) pthread_mutex_destroy(mutex)
+#define mutex_lock(mutex) pthread_mutex_lock(mutex)
+#define mutex_unlock(mutex) pthread_mutex_unlock(mutex)
+#endif
+
+static void stop_worker(struct sync_device *d);
+#endif
 
 static inline void sockio_close(struct sync_device *d)
 {
+#ifdef SYNC_EDITOR_THREAD
+	stop_worker(d);
+#endif
 	d->sockio_cb.close(d->sockio_ctxt);
 	d->sockio_ctxt = NULL;
 }
@@ -152,17 +211,37 @@ struct sync_device *sync_create_device(const char *base)
 	}
 
 	d->tracks = NULL;
+	d->track_hashes = NULL;
 	d->num_tracks = 0;
+	d->key_block = NULL;
+#ifdef GEKKO
+	d->json_loaded = 0;
+#endif
 
 #ifndef SYNC_PLAYER
 	d->row = -1;
 	d->sockio_ctxt = NULL;
+#ifdef SYNC_EDITOR_THREAD
+	mutex_init(&d->lock);
+	d->worker_running = 0;
+	d->shadow = NULL;
+	d->shadow_dirty = NULL;
+	d->num_shadow = 0;
+	d->events = NULL;
+	d->num_events = 0;
+	d->max_events = 0;
+#endif
 #endif
 
 	d->io_cb.open = (void *(*)(const char *, const char *))fopen;
 	d->io_cb.read = (size_t (*)(void *, size_t, size_t, void *))fread;
 	d->io_cb.close = (int (*)(void *))fclose;
 
+#ifdef SYNC_PLAYER
+	/* tracks come from the bundle if there is one */
+	load_bundle(d, sync_bundle_path(d->base));
+#endif
+
 	return d;
 }
 
@@ -175,14 +254,26 @@ void sync_destroy_device(struct sync_device *d)
 		sockio_close(d);
 
 	sync_tcp_device_dtor();
+
+#ifdef SYNC_EDITOR_THREAD
+	for (i = 0; i < (int)d->num_shadow; ++i)
+		free(d->shadow[i].keys);
+	free(d->shadow);
+	free(d->shadow_dirty);
+	free(d->events);
+	mutex_destroy(&d->lock);
+#endif
 #endif
 
 	for (i = 0; i < (int)d->num_tracks; ++i) {
 		free(d->tracks[i]->name);
-		free(d->tracks[i]->keys);
+		if (!d->key_block)
+			free(d->tracks[i]->keys);
 		free(d->tracks[i]);
 	}
 	free(d->tracks);
+	free(d->track_hashes);
+	free(d->key_block);
 	free(d->base);
 	free(d);
 }
@@ -196,6 +287,7 @@ static int read_track_data(struct sync_device *d, struct sync_track *t)
 
 	d->io_cb.read(&t->num_keys, sizeof(int), 1, fp);
 	t->keys = malloc(sizeof(struct track_key) * t->num_keys);
+	t->max_keys = t->num_keys;
 	if (!t->keys)
 		return -1;
 
@@ -300,52 +392,274 @@ static int fetch_track_data(struct sync_device *d, struct sync_track *t)
 	return 0;
 }
 
-static int handle_set_key_cmd(struct sync_device *d)
+/* Size of the fixed payload following each command byte */
+static int cmd_payload_size(unsigned char cmd)
 {
-	uint32_t track, row;
-	union {
-		float f;
-		uint32_t i;
-	} v;
-	struct track_key key;
-	unsigned char type;
-
-	if (sockio_recv(d, (char *)&track, sizeof(track)) ||
-	    sockio_recv(d, (char *)&row, sizeof(row)) ||
-	    sockio_recv(d, (char *)&v.i, sizeof(v.i)) ||
-	    sockio_recv(d, (char *)&type, 1))
+	switch (cmd) {
+	case SET_KEY:
+		return 13;
+	case DELETE_KEY:
+		return 8;
+	case SET_ROW:
+		return 4;
+	case PAUSE:
+		return 1;
+	case SAVE_TRACKS:
+		return 0;
+	default:
 		return -1;
+	}
+}
 
-	track = ntohl(track);
-	v.i = ntohl(v.i);
+static uint32_t read_u32(const unsigned char *buf)
+{
+	uint32_t v;
+	memcpy(&v, buf, sizeof(v));
+	return ntohl(v);
+}
 
-	key.row = ntohl(row);
-	key.value = v.f;
+/* Read one command, the payload arrives with a single receive */
+static int recv_cmd(struct sync_device *d, struct sync_cmd *c)
+{
+	unsigned char buf[13];
+	uint32_t value;
+	int size;
 
-	if (type >= KEY_TYPE_COUNT || track >= d->num_tracks)
+	if (sockio_recv(d, &c->cmd, 1))
+		return -1;
+
+	size = cmd_payload_size(c->cmd);
+	if (size < 0) {
+		fprintf(stderr, "unknown cmd: %02x\n", c->cmd);
+		return -1;
+	}
+	if (size && sockio_recv(d, buf, size))
 		return -1;
 
-	key.type = (enum key_type)type;
-	return sync_set_key(d->tracks[track], &key);
+	switch (c->cmd) {
+	case SET_KEY:
+		value = read_u32(buf + 8);
+		memcpy(&c->value, &value, sizeof(float));
+		c->type = buf[12];
+		/* fall through */
+	case DELETE_KEY:
+		c->track = read_u32(buf);
+		c->row = read_u32(buf + 4);
+		break;
+	case SET_ROW:
+		c->row = read_u32(buf);
+		break;
+	case PAUSE:
+		c->type = buf[0];
+		break;
+	}
+	return 0;
 }
 
-static int handle_del_key_cmd(struct sync_device *d)
+static int apply_key_cmd(struct sync_track *t, const struct sync_cmd *c)
 {
-	uint32_t track, row;
+	struct track_key key;
+
+	if (c->cmd == DELETE_KEY)
+		return sync_del_key(t, (int)c->row);
 
-	if (sockio_recv(d, (char *)&track, sizeof(track)) ||
-	    sockio_recv(d, (char *)&row, sizeof(row)))
+	if (c->type >= KEY_TYPE_COUNT)
 		return -1;
 
-	track = ntohl(track);
-	row = ntohl(row);
+	key.row = (int)c->row;
+	key.value = c->value;
+	key.type = (enum key_type)c->type;
+	return sync_set_key(t, &key);
+}
+
+/* Commands that call back into the demo, run on the render thread */
+static void run_cmd(struct sync_device *d, const struct sync_cmd *c,
+    struct sync_cb *cb, void *cb_param)
+{
+	switch (c->cmd) {
+	case SET_ROW:
+		if (cb && cb->set_row)
+			cb->set_row(cb_param, (int)c->row);
+		break;
+	case PAUSE:
+		if (cb && cb->pause)
+			cb->pause(cb_param, c->type);
+		break;
+	case SAVE_TRACKS:
+		sync_save_tracks(d);
+		break;
+	}
+}
+
+static void clear_keys(struct sync_track *t)
+{
+	free(t->keys);
+	t->keys = NULL;
+	t->num_keys = 0;
+	t->max_keys = 0;
+	t->edits++;
+}
+
+#ifdef SYNC_EDITOR_THREAD
+
+static int push_event(struct sync_device *d, const struct sync_cmd *c)
+{
+	if (d->num_events == d->max_events) {
+		int max_events = d->max_events ? d->max_events * 2 : 16;
+		void *tmp = realloc(d->events, sizeof(d->events[0]) * max_events);
+		if (!tmp)
+			return -1;
+		d->events = tmp;
+		d->max_events = max_events;
+	}
+	d->events[d->num_events++] = *c;
+	return 0;
+}
+
+#define EDITOR_WAIT_MS 10
+#define EDITOR_CMD_BATCH 64
+
+/* Decodes editor commands off the render thread. Key edits go to the
+ * shadow tracks, everything else is queued for sync_update. Commands
+ * that are already buffered are applied under one lock. */
+static void *editor_worker(void *arg)
+{
+	struct sync_device *d = arg;
+	struct sync_cmd cmds[EDITOR_CMD_BATCH];
+
+	while (!d->worker_stop) {
+		int readable = 0, err = 0, ready, i, n = 0;
+
+		/* the timeout only bounds how long stop_worker waits */
+		if (d->sockio_cb.wait)
+			ready = d->sockio_cb.wait(d->sockio_ctxt, &readable, EDITOR_WAIT_MS);
+		else
+			ready = sockio_poll(d, &readable, NULL);
+		if (ready < 0)
+			break;
+		if (!ready || !readable) {
+			if (!d->sockio_cb.wait)
+				usleep(1000);
+			continue;
+		}
+
+		do {
+			if (recv_cmd(d, cmds + n)) {
+				err = 1;
+				break;
+			}
+			readable = 0;
+		} while (++n < EDITOR_CMD_BATCH && sockio_poll(d, &readable, NULL) > 0 && readable);
+
+		mutex_lock(&d->lock);
+		for (i = 0; i < n && !err; ++i) {
+			const struct sync_cmd *c = cmds + i;
+			if (c->cmd == SET_KEY || c->cmd == DELETE_KEY) {
+				err = c->track >= d->num_shadow ||
+				    apply_key_cmd(d->shadow + c->track, c);
+				if (!err)
+					d->shadow_dirty[c->track] = 1;
+			} else
+				err = push_event(d, c);
+		}
+		mutex_unlock(&d->lock);
+
+		if (err)
+			break;
+	}
 
-	if (track >= d->num_tracks)
+	if (!d->worker_stop)
+		d->worker_error = 1;
+	return NULL;
+}
+
+static int start_worker(struct sync_device *d)
+{
+	d->worker_stop = 0;
+	d->worker_error = 0;
+	if (thread_start(&d->worker, editor_worker, d))
 		return -1;
+	d->worker_running = 1;
+	return 0;
+}
+
+static void stop_worker(struct sync_device *d)
+{
+	if (!d->worker_running)
+		return;
+	d->worker_stop = 1;
+	thread_join(d->worker);
+	d->worker_running = 0;
+}
+
+/* Track idx of the shadow array, called whenever a track is created */
+static int add_shadow_track(struct sync_device *d)
+{
+	struct sync_track *t;
+	void *tmp;
+	int result = -1;
+
+	mutex_lock(&d->lock);
+	tmp = realloc(d->shadow_dirty, sizeof(d->shadow_dirty[0]) * (d->num_shadow + 1));
+	if (tmp) {
+		d->shadow_dirty = tmp;
+		tmp = realloc(d->shadow, sizeof(d->shadow[0]) * (d->num_shadow + 1));
+	}
+	if (tmp) {
+		d->shadow = tmp;
+		t = d->shadow + d->num_shadow;
+		t->name = NULL;
+		t->keys = NULL;
+		t->num_keys = 0;
+		t->max_keys = 0;
+		t->edits = 0;
+		d->shadow_dirty[d->num_shadow++] = 0;
+		result = 0;
+	}
+	mutex_unlock(&d->lock);
+	return result;
+}
+
+static int copy_keys(struct sync_track *dst, const struct sync_track *src)
+{
+	if (dst->max_keys < src->num_keys) {
+		void *tmp = realloc(dst->keys, sizeof(struct track_key) * src->max_keys);
+		if (!tmp)
+			return -1;
+		dst->keys = tmp;
+		dst->max_keys = src->max_keys;
+	}
+	if (src->num_keys)
+		memcpy(dst->keys, src->keys, sizeof(struct track_key) * src->num_keys);
+	dst->num_keys = src->num_keys;
+	dst->edits++;
+	return 0;
+}
+
+/* Bring the edits of the worker over at frame start */
+static int apply_shadow_tracks(struct sync_device *d, struct sync_cb *cb,
+    void *cb_param)
+{
+	int i, result = d->worker_error ? -1 : 0;
+
+	mutex_lock(&d->lock);
+	for (i = 0; i < (int)d->num_shadow; ++i) {
+		if (d->shadow_dirty[i]) {
+			if (copy_keys(d->tracks[i], d->shadow + i))
+				result = -1;
+			d->shadow_dirty[i] = 0;
+		}
+	}
+	for (i = 0; i < d->num_events; ++i)
+		run_cmd(d, d->events + i, cb, cb_param);
+	d->num_events = 0;
+	mutex_unlock(&d->lock);
 
-	return sync_del_key(d->tracks[track], row);
+	return result;
 }
 
+#endif /* defined(SYNC_EDITOR_THREAD) */
+
 static int server_greet(struct sync_device *d)
 {
 	char greet[128];
@@ -358,11 +672,15 @@ static int server_greet(struct sync_device *d)
 		return -1;
 	}
 
-	for (i = 0; i < (int)d->num_tracks; ++i) {
-		free(d->tracks[i]->keys);
-		d->tracks[i]->keys = NULL;
-		d->tracks[i]->num_keys = 0;
+	for (i = 0; i < (int)d->num_tracks; ++i)
+		clear_keys(d->tracks[i]);
+#ifdef SYNC_EDITOR_THREAD
+	for (i = 0; i < (int)d->num_shadow; ++i) {
+		clear_keys(d->shadow + i);
+		d->shadow_dirty[i] = 0;
 	}
+	d->num_events = 0;
+#endif
 
 	for (i = 0; i < (int)d->num_tracks; ++i) {
 		if (fetch_track_data(d, d->tracks[i])) {
@@ -371,6 +689,12 @@ static int server_greet(struct sync_device *d)
 		}
 	}
 
+#ifdef SYNC_EDITOR_THREAD
+	if (start_worker(d)) {
+		sockio_close(d);
+		return -1;
+	}
+#endif
 	return 0;
 }
 
@@ -379,6 +703,8 @@ static int server_greet(struct sync_device *d)
  * How the connection ends and cleans itself up is implemented by .close().
  * ctxt must already be allocated, connected, and ready to be used with the provided methods.
  * The device takes ownership of ctxt, to be cleaned up by the .close() method to disconnect.
+ * Unless SYNC_NO_THREADS is defined the callbacks are used from a worker thread
+ * after the handshake, .send() also from the thread calling sync_update().
  *
  * Returns 0 on success, -1 on error, which may occur since this performs the
  * initial Rocket handshake.  Even in error ctxt will be closed.
@@ -405,48 +731,32 @@ int sync_set_sockio_cb(struct sync_device *d, struct sync_sockio_cb *cb, void *c
 int sync_update(struct sync_device *d, int row, struct sync_cb *cb,
     void *cb_param)
 {
-	int readable;
-
 	if (!d->sockio_ctxt)
 		return -1;
 
-	/* look for new commands */
-	while (sockio_poll(d, &readable, NULL) > 0) {
-		unsigned char cmd = 0, flag;
-		uint32_t new_row;
+#ifdef SYNC_EDITOR_THREAD
+	if (apply_shadow_tracks(d, cb, cb_param))
+		goto sockerr;
+#else
+	{
+		int readable;
 
-		if (sockio_recv(d, (char *)&cmd, 1))
-			goto sockerr;
+		/* look for new commands */
+		while (sockio_poll(d, &readable, NULL) > 0) {
+			struct sync_cmd c;
 
-		switch (cmd) {
-		case SET_KEY:
-			if (handle_set_key_cmd(d))
+			if (recv_cmd(d, &c))
 				goto sockerr;
-			break;
-		case DELETE_KEY:
-			if (handle_del_key_cmd(d))
-				goto sockerr;
-			break;
-		case SET_ROW:
-			if (sockio_recv(d, (char *)&new_row, sizeof(new_row)))
-				goto sockerr;
-			if (cb && cb->set_row)
-				cb->set_row(cb_param, ntohl(new_row));
-			break;
-		case PAUSE:
-			if (sockio_recv(d, (char *)&flag, 1))
-				goto sockerr;
-			if (cb && cb->pause)
-				cb->pause(cb_param, flag);
-			break;
-		case SAVE_TRACKS:
-			sync_save_tracks(d);
-			break;
-		default:
-			fprintf(stderr, "unknown cmd: %02x\n", cmd);
-			goto sockerr;
+
+			if (c.cmd == SET_KEY || c.cmd == DELETE_KEY) {
+				if (c.track >= d->num_tracks ||
+				    apply_key_cmd(d->tracks[c.track], &c))
+					goto sockerr;
+			} else
+				run_cmd(d, &c, cb, cb_param);
 		}
 	}
+#endif
 
 	if (cb && cb->is_playing && cb->is_playing(cb_param)) {
 		if (d->row != row && d->sockio_ctxt) {
@@ -478,77 +788,132 @@ static int create_track(struct sync_device *d, const char *name)
 		return -1;
 
 	t->name = strdup(name);
+	if (!t->name)
+		goto fail;
 	t->keys = NULL;
 	t->num_keys = 0;
+	t->max_keys = 0;
+	t->edits = 0;
+
+	tmp = realloc(d->track_hashes, sizeof(d->track_hashes[0]) * (d->num_tracks + 1));
+	if (!tmp)
+		goto fail;
+	d->track_hashes = tmp;
 
 	tmp = realloc(d->tracks, sizeof(d->tracks[0]) * (d->num_tracks + 1));
-	if (!tmp) {
-		free(t);
-		return -1;
-	}
+	if (!tmp)
+		goto fail;
 
 	d->tracks = tmp;
+
+#ifdef SYNC_EDITOR_THREAD
+	if (add_shadow_track(d))
+		goto fail;
+#endif
+
+	d->track_hashes[d->num_tracks] = track_name_hash(name);
 	d->tracks[d->num_tracks++] = t;
 
 	return (int)d->num_tracks - 1;
-}
 
-#ifdef GEKKO
-// Simplified JSON parser for N64 and Wii
-static struct sync_track* parse_json_track(const char* json, const char* name) {
-	char buffer[256];
-	struct sync_track* track = NULL;
-	const char* pos = json;
+fail:
+	free(t->name);
+	free(t);
+	return -1;
+}
 
-	// Search for track name
-	snprintf(buffer, sizeof(buffer), "\"name\":\"%s\"", name);
-	pos = strstr(pos, buffer);
-	if (!pos) return NULL;
+#define SYNC_JSON_PATH "sourcefiles/rocket.json"
 
-	// Find keys array
-	pos = strstr(pos, "\"keys\":[");
-	if (!pos) return NULL;
-	pos += 7;
+// Simplified JSON parser for N64 and Wii
+// Reads the keys of one track, pos points to the keys array
+static const char* parse_json_keys(const char* pos, struct sync_track* track) {
+	const char* end = strchr(pos, ']');
+	if (!end) return NULL;
 
 	// Count keys
 	int num_keys = 0;
-	const char* key_start = pos;
-	while (*key_start && *key_start != ']') {
-		if (*key_start == '{') num_keys++;
-		key_start++;
+	for (const char* c = pos; c < end; c++) {
+		if (*c == '{') num_keys++;
 	}
 
-	track = malloc(sizeof(struct sync_track));
 	track->keys = malloc(num_keys * sizeof(struct track_key));
+	if (num_keys > 0 && !track->keys) return NULL;
 	track->num_keys = num_keys;
-	track->name = strdup(name);
+	track->max_keys = num_keys;
 
-	// Parse keys
+	// Parse keys, every field must be found before the end of this track's array
 	for (int i = 0; i < num_keys; i++) {
 		pos = strchr(pos, '{');
-		if (!pos) break;
+		if (!pos || pos >= end)
+			goto fail;
 
 		// Parse row
 		pos = strstr(pos, "\"row\":");
-		track->keys[i].row = atoi(pos + 6);
+		if (!pos || pos >= end)
+			goto fail;
+		track->keys[i].row = (int)strtol(pos + 6, (char**)&pos, 10);
 
 		// Parse value
 		pos = strstr(pos, "\"value\":");
-		track->keys[i].value = atof(pos + 8);
+		if (!pos || pos >= end)
+			goto fail;
+		track->keys[i].value = (float)strtod(pos + 8, (char**)&pos);
 
 		// Parse type
 		pos = strstr(pos, "\"type\":");
-		track->keys[i].type = atoi(pos + 7);
+		if (!pos || pos >= end)
+			goto fail;
+		track->keys[i].type = (enum key_type)strtol(pos + 7, (char**)&pos, 10);
 	}
 
-	return track;
+	return end + 1;
+
+fail:
+	free(track->keys);
+	track->keys = NULL;
+	track->num_keys = 0;
+	track->max_keys = 0;
+	return NULL;
 }
-const struct sync_track* sync_get_track(struct sync_device* d, const char* name) {
-	FILE* file = fopen("sourcefiles/rocket.json", "r");
+
+// Parse every track of the file in one pass into the device track table
+static int parse_json_tracks(struct sync_device* d, const char* json) {
+	char name[256];
+	const char* pos = json;
+
+	while ((pos = strstr(pos, "\"name\":\"")) != NULL) {
+		pos += 8;
+		const char* name_end = strchr(pos, '"');
+		if (!name_end) break;
+
+		size_t name_len = name_end - pos;
+		if (name_len >= sizeof(name)) name_len = sizeof(name) - 1;
+		memcpy(name, pos, name_len);
+		name[name_len] = '\0';
+
+		// Find keys array
+		pos = strstr(name_end, "\"keys\":[");
+		if (!pos) break;
+		pos += 7;
+
+		if (find_track(d, name) >= 0) continue;
+		int idx = create_track(d, name);
+		if (idx < 0) return -1;
+
+		pos = parse_json_keys(pos, d->tracks[idx]);
+		if (!pos) return -1;
+	}
+	return 0;
+}
+
+int sync_load_json_tracks(struct sync_device* d, const char* path) {
+#ifdef GEKKO
+	u64 start = gettime();
+#endif
+	FILE* file = fopen(path, "r");
 	if (!file) {
-		printf("File open FAILED sourcefiles/rocket.json %s\n", name);
-		//wait_ms(1000);
-		return NULL;
+		printf("File open FAILED %s\n", path);
+		return -1;
 	}
 
 	fseek(file, 0, SEEK_END);
@@ -556,14 +921,192 @@ const struct sync_track* sync_get_track(struct sync_device* d, const char* name)
 	fseek(file, 0, SEEK_SET);
 
 	char* json = malloc(length + 1);
+	if (!json) {
+		fclose(file);
+		return -1;
+	}
 	fread(json, 1, length, file);
 	json[length] = '\0';
 	fclose(file);
 
-	struct sync_track* track = parse_json_track(json, name);
+	int result = parse_json_tracks(d, json);
 	free(json);
 
-	return track;
+#ifdef GEKKO
+	printf("Loaded %d tracks from %s in %u us\n", (int)d->num_tracks, path,
+	       (unsigned int)ticks_to_microsecs(gettime() - start));
+#endif
+	return result;
+}
+
+#ifdef SYNC_PLAYER
+
+static const char *sync_bundle_path(const char *base)
+{
+	static char temp[FILENAME_MAX];
+	strncpy(temp, "sourcefiles/", sizeof(temp) - 1);
+	temp[sizeof(temp) - 1] = '\0';
+	strncat(temp, base, sizeof(temp) - strlen(temp) - 1);
+	strncat(temp, SYNC_BUNDLE_EXT, sizeof(temp) - strlen(temp) - 1);
+	return temp;
+}
+
+/* count elements of elem_size bytes at offset fit in size bytes, without overflow */
+static int bundle_fits(uint32_t size, uint32_t offset, uint32_t count, uint32_t elem_size)
+{
+	return offset <= size && count <= (size - offset) / elem_size;
+}
+
+static int parse_bundle(struct sync_device *d, unsigned char *data)
+{
+	struct sync_bundle_header *h = (struct sync_bundle_header *)data;
+	struct sync_bundle_track *index = (struct sync_bundle_track *)(data + sizeof(*h));
+	uint32_t *rows, *values;
+	unsigned char *types;
+	const char *names;
+	uint32_t i, k, names_size;
+	int swapped = h->magic == sync_bundle_swap32(SYNC_BUNDLE_MAGIC);
+
+	/* the header first, the arrays only once they are known to fit */
+	if (swapped) {
+		uint32_t *words = (uint32_t *)h;
+		for (i = 0; i < sizeof(*h) / 4; ++i)
+			words[i] = sync_bundle_swap32(words[i]);
+	}
+
+	if (h->version != SYNC_BUNDLE_VERSION ||
+	    (h->rows_offset & 3) || (h->values_offset & 3) ||
+	    !bundle_fits(h->size, sizeof(*h), h->num_tracks, sizeof(*index)) ||
+	    !bundle_fits(h->size, h->rows_offset, h->num_keys, 4) ||
+	    !bundle_fits(h->size, h->values_offset, h->num_keys, 4) ||
+	    !bundle_fits(h->size, h->types_offset, h->num_keys, 1) ||
+	    h->names_offset > h->size)
+		return -1;
+
+	rows = (uint32_t *)(data + h->rows_offset);
+	values = (uint32_t *)(data + h->values_offset);
+	types = data + h->types_offset;
+	names = (const char *)data + h->names_offset;
+	names_size = h->size - h->names_offset;
+
+	/* index and key arrays are 32-bit words */
+	if (swapped) {
+		uint32_t *words = (uint32_t *)index;
+		for (i = 0; i < h->num_tracks * 4; ++i)
+			words[i] = sync_bundle_swap32(words[i]);
+		for (k = 0; k < h->num_keys; ++k) {
+			rows[k] = sync_bundle_swap32(rows[k]);
+			values[k] = sync_bundle_swap32(values[k]);
+		}
+	}
+
+	d->key_block = malloc(sizeof(struct track_key) * (h->num_keys ? h->num_keys : 1));
+	if (!d->key_block)
+		return -1;
+
+	for (k = 0; k < h->num_keys; ++k) {
+		struct track_key *key = d->key_block + k;
+		key->row = (int)rows[k];
+		memcpy(&key->value, values + k, sizeof(float));
+		key->type = (enum key_type)types[k];
+	}
+
+	for (i = 0; i < h->num_tracks; ++i) {
+		struct sync_track *t;
+		int idx;
+		if (index[i].first_key > h->num_keys ||
+		    index[i].num_keys > h->num_keys - index[i].first_key ||
+		    index[i].name_offset >= names_size ||
+		    !memchr(names + index[i].name_offset, '\0', names_size - index[i].name_offset) ||
+		    find_track(d, names + index[i].name_offset) >= 0)
+			return -1;
+
+		idx = create_track(d, names + index[i].name_offset);
+		if (idx < 0)
+			return -1;
+
+		t = d->tracks[idx];
+		t->keys = d->key_block + index[i].first_key;
+		t->num_keys = (int)index[i].num_keys;
+		t->max_keys = t->num_keys;
+	}
+	return 0;
+}
+
+/* Load all tracks from the bundle with one read of the file body */
+static int load_bundle(struct sync_device *d, const char *path)
+{
+	struct sync_bundle_header h;
+	unsigned char *data;
+	uint32_t size;
+	int result;
+	void *fp = d->io_cb.open(path, "rb");
+	if (!fp)
+		return -1;
+
+	if (d->io_cb.read(&h, sizeof(h), 1, fp) != 1) {
+		d->io_cb.close(fp);
+		return -1;
+	}
+
+	if (h.magic == SYNC_BUNDLE_MAGIC)
+		size = h.size;
+	else if (h.magic == sync_bundle_swap32(SYNC_BUNDLE_MAGIC))
+		size = sync_bundle_swap32(h.size);
+	else
+		size = 0;
+
+	if (size < sizeof(h)) {
+		d->io_cb.close(fp);
+		return -1;
+	}
+
+	data = malloc(size);
+	if (!data) {
+		d->io_cb.close(fp);
+		return -1;
+	}
+
+	memcpy(data, &h, sizeof(h));
+	result = d->io_cb.read(data + sizeof(h), size - sizeof(h), 1, fp) == 1 ? 0 : -1;
+	d->io_cb.close(fp);
+
+	if (!result)
+		result = parse_bundle(d, data);
+	free(data);
+
+	if (result) {
+		/* drop whatever was read so the other backends can take over */
+		int i;
+		for (i = 0; i < (int)d->num_tracks; ++i) {
+			free(d->tracks[i]->name);
+			free(d->tracks[i]);
+		}
+		d->num_tracks = 0;
+		free(d->key_block);
+		d->key_block = NULL;
+		printf("Bundle %s is broken\n", path);
+	} else
+		printf("Loaded %d tracks from %s\n", (int)d->num_tracks, path);
+	return result;
+}
+
+#endif /* defined(SYNC_PLAYER) */
+
+#ifdef GEKKO
+
+const struct sync_track* sync_get_track(struct sync_device* d, const char* name) {
+	if (!d->key_block && !d->json_loaded) {
+		sync_load_json_tracks(d, SYNC_JSON_PATH);
+		d->json_loaded = 1;
+	}
+
+	int idx = find_track(d, name);
+	if (idx < 0) {
+		printf("Track %s not found\n", name);
+		return NULL;
+	}
+	return d->tracks[idx];
 }
 
 #else
@@ -576,6 +1119,10 @@ const struct sync_track *sync_get_track(struct sync_device *d,
 	if (idx >= 0)
 		return d->tracks[idx];
 
+	/* the bundle holds every track there is */
+	if (d->key_block)
+		return NULL;
+
 	idx = create_track(d, name);
 	if (idx < 0)
 		return NULL;
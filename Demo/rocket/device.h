@@ -56,19 +56,67 @@
  #define closesocket(x) close(x)
 #endif
 
+/* configure the editor connection thread */
+#if defined(_WIN32) || defined(USE_AMITCP)
+ #define SYNC_NO_THREADS
+#endif
+#ifndef SYNC_NO_THREADS
+ #define SYNC_EDITOR_THREAD
+ #ifdef GEKKO
+  #include <ogc/lwp.h>
+  #include <ogc/mutex.h>
+  #include <unistd.h>
+  typedef lwp_t sync_thread_t;
+  typedef mutex_t sync_mutex_t;
+ #else
+  #include <pthread.h>
+  typedef pthread_t sync_thread_t;
+  typedef pthread_mutex_t sync_mutex_t;
+ #endif
+#endif
+
+/* One decoded editor command */
+struct sync_cmd {
+	unsigned char cmd;
+	unsigned char type; /* key type of SET_KEY, flag of PAUSE */
+	uint32_t track, row;
+	float value;
+};
+
 #endif /* !defined(SYNC_PLAYER) */
 
 struct sync_device {
 	char *base;
 	struct sync_track **tracks;
+	uint32_t *track_hashes; /* name hash of each track, checked before strcmp */
 	size_t num_tracks;
+	struct track_key *key_block; /* keys of all tracks when loaded from a bundle */
+#ifdef GEKKO
+	int json_loaded;
+#endif
 
 #ifndef SYNC_PLAYER
 	int row;
 	struct sync_sockio_cb sockio_cb;
 	void *sockio_ctxt;
+#ifdef SYNC_EDITOR_THREAD
+	/* The worker reads the socket and applies key edits to the shadow
+	 * tracks, sync_update copies the dirty ones into tracks. */
+	sync_thread_t worker;
+	sync_mutex_t lock;
+	int worker_running;
+	volatile int worker_stop, worker_error;
+	struct sync_track *shadow; /* parallel to tracks */
+	unsigned char *shadow_dirty;
+	size_t num_shadow;
+	struct sync_cmd *events; /* commands for the render thread */
+	int num_events, max_events;
+#endif
 #endif
 	struct sync_io_cb io_cb;
 };
 
+/* Load every track of a rocket.json written by save_sync */
+int sync_load_json_tracks(struct sync_device *d, const char *path);
+
 #endif /* SYNC_DEVICE_H */
@@ -1,7 +1,9 @@
 #include "rocket_ctoy.h"
 
+#include <math.h>
 #include <stdbool.h>
 #include <stdio.h>
+#include <string.h>
 
 #include "device.h"
 #include "sync.h"
@@ -12,12 +14,54 @@
 static struct sync_device *rocket;
 // Array to hold Rocket variables
 static RocketVariable rocketVariables[MAX_VARIABLES];
+// Values of all variables at the current frame, filled by rocket_evaluate_frame
+static float rocketValues[MAX_VARIABLES];
+// Tracks evaluated exactly, packed for sync_get_vals_cursor
+static const struct sync_track* exactTracks[MAX_VARIABLES];
+static int exactCursors[MAX_VARIABLES];
+static unsigned short exactIds[MAX_VARIABLES];
+static float exactValues[MAX_VARIABLES];
+static int exactCount = 0;
+// Bit per variable that changed since the previous frame
+static unsigned int dirtyMask[DIRTY_MASK_WORDS];
+static double evaluatedRow = 0.0;
+static bool frameEvaluated = false;
+static RocketFrameStats frameStats;
+static RocketFrameStats lastFrameStats;
 
 static double bpm = 125, rpb = 8;
 static double row_rate;
 static double row;
+// Editor seeks and pauses move the row away from the elapsed time
+static double rowOffset = 0.0;
+static double elapsedSeconds = 0.0;
+static bool editorPaused = false;
 static int rocket_initialized = 0;
 
+#ifndef SYNC_PLAYER
+static bool editorSeeked = false;
+
+static void editor_pause(void *param, int flag) {
+    editorPaused = flag != 0;
+}
+
+static void editor_set_row(void *param, int new_row) {
+    row = new_row;
+    rowOffset = row - elapsedSeconds * row_rate;
+    editorSeeked = true;
+}
+
+static int editor_is_playing(void *param) {
+    return !editorPaused;
+}
+
+static struct sync_cb editorCallbacks = {
+    editor_pause,
+    editor_set_row,
+    editor_is_playing
+};
+#endif
+
 struct sync_device * initialize_rocket_device() {
     if (rocket_initialized == 0) {
         rocket = sync_create_device("sync");
@@ -41,6 +85,20 @@ struct sync_device * initialize_rocket_device() {
 
 int rocketVariableCount = 0;  // Number of variables currently stored
 
+// Collect the variables that have a track but no baked table
+static void rebuild_exact_tracks(void) {
+    exactCount = 0;
+    for (int i = 0; i < rocketVariableCount; i++) {
+        RocketVariable *var = &rocketVariables[i];
+        if (var->track && !var->baked) {
+            exactTracks[exactCount] = var->track;
+            exactCursors[exactCount] = -1;
+            exactIds[exactCount] = i;
+            exactCount++;
+        }
+    }
+}
+
 // Function to add a new variable to the dictionary
 unsigned short add_to_rocket(const char *name) {
     // Check if the variable already exists
@@ -50,29 +108,186 @@ unsigned short add_to_rocket(const char *name) {
         }
     }
 
+    // Tracks are owned by the device, create it on first use
+    if (initialize_rocket_device() == NULL) {
+        return 0;
+    }
+
     // Add a new variable if it doesn't exist
     if (rocketVariableCount < MAX_VARIABLES) {
         strncpy(rocketVariables[rocketVariableCount].name, name, MAX_NAME_LENGTH);
         // Get and store the track pointer once during initialization
         rocketVariables[rocketVariableCount].track = sync_get_track(rocket, name);
+        rocketVariables[rocketVariableCount].baked = NULL;
+        rocketVariables[rocketVariableCount].segment = -1;
+        rocketVariables[rocketVariableCount].edits = rocketVariables[rocketVariableCount].track ?
+            rocketVariables[rocketVariableCount].track->edits : 0;
         rocketVariableCount++;
+        rebuild_exact_tracks();
     } else {
         printf("Rocket variable storage full! Cannot add more variables.\n");
     }
     return rocketVariableCount - 1;
 }
 
+// Compare the key segments of the previous and this row
+static void update_dirty_mask(double eval_row) {
+    memset(dirtyMask, 0, sizeof(dirtyMask));
+    for (int i = 0; i < rocketVariableCount; i++) {
+        RocketVariable *var = &rocketVariables[i];
+        if (!var->track) {
+            continue;
+        }
+        int previous = var->segment;
+        sync_key_idx_cursor(var->track, (int)floor(eval_row), &var->segment);
+        bool changed = !frameEvaluated ||
+            (eval_row != evaluatedRow &&
+             (var->segment != previous || !sync_segment_is_constant(var->track, var->segment)));
+        // Keys set or deleted by the editor since the last frame
+        if (var->track->edits != var->edits) {
+            var->edits = var->track->edits;
+            changed = true;
+        }
+        if (changed) {
+            dirtyMask[i / 32] |= 1u << (i % 32);
+        }
+    }
+    evaluatedRow = eval_row;
+    frameEvaluated = true;
+}
+
+// Evaluate every variable once for this frame
+void rocket_evaluate_frame(double eval_row) {
+    lastFrameStats = frameStats;
+    frameStats.evaluations = 0;
+    frameStats.reads = 0;
+
+#ifndef SYNC_PLAYER
+    // Key edits from the editor are applied here and bump the edits of their tracks
+    if (rocket) {
+        editorSeeked = false;
+        sync_update(rocket, (int)floor(eval_row), &editorCallbacks, NULL);
+        if (editorSeeked) {
+            eval_row = row;
+        }
+    }
+#endif
+    update_dirty_mask(eval_row);
+
+#ifdef SYNC_PLAYER
+    for (int i = 0; i < rocketVariableCount; i++) {
+        RocketVariable *var = &rocketVariables[i];
+        if (var->baked) {
+            rocketValues[i] = sync_get_baked_val(var->baked, eval_row);
+            frameStats.evaluations++;
+        }
+    }
+#endif
+
+    sync_get_vals_cursor(exactTracks, exactCount, eval_row, exactValues, exactCursors);
+    for (int i = 0; i < exactCount; i++) {
+        rocketValues[exactIds[i]] = exactValues[i];
+    }
+    frameStats.evaluations += exactCount;
+}
+
 // Function to retrieve the value of a variable from the dictionary
 float get_from_rocket(unsigned short id) {
+    if (id >= rocketVariableCount) {
+        return 0.0f;  // Return default value for invalid ID
+    }
+    frameStats.reads++;
+    // Missing tracks were stored as 0 in rocket_evaluate_frame
+    return rocketValues[id];
+}
+
+bool rocket_changed(unsigned short id) {
+    if (id >= rocketVariableCount) {
+        return false;
+    }
+    return (dirtyMask[id / 32] & (1u << (id % 32))) != 0;
+}
+
+bool rocket_changed_since(unsigned short id, double since_row) {
+    if (id >= rocketVariableCount || !rocketVariables[id].track) {
+        return false;
+    }
+    return sync_track_changed(rocketVariables[id].track, since_row, evaluatedRow) != 0;
+}
+
+const unsigned int* get_rocket_dirty_mask(void) {
+    return dirtyMask;
+}
+
+void get_from_rocket_range(unsigned short id, float row_offset, float row_step, int n, float *out) {
     if (id >= rocketVariableCount || !rocketVariables[id].track) {
-        return 0.0f;  // Return default value for invalid ID or missing track
+        for (int i = 0; i < n; i++) {
+            out[i] = 0.0f;
+        }
+        return;
+    }
+    double row0 = row + row_offset;
+#ifdef SYNC_PLAYER
+    if (rocketVariables[id].baked) {
+        for (int i = 0; i < n; i++) {
+            out[i] = sync_get_baked_val(rocketVariables[id].baked, row0 + row_step * i);
+        }
+        return;
     }
-    // Get the current value from the track using the current row
-    return sync_get_val(rocketVariables[id].track, row);
+#endif
+    sync_get_val_range(rocketVariables[id].track, row0, row_step, n, out);
+}
+
+void rocket_bake_tracks(int samples_per_row, float max_error)
+{
+#ifdef SYNC_PLAYER
+    int total_bytes = 0;
+    for (int i = 0; i < rocketVariableCount; i++) {
+        RocketVariable *var = &rocketVariables[i];
+        if (!var->track || var->baked) {
+            continue;
+        }
+        struct sync_baked_track *baked = malloc(sizeof(struct sync_baked_track));
+        if (!baked || sync_bake_track(var->track, samples_per_row, baked)) {
+            free(baked);
+            continue;
+        }
+        int bytes = sync_baked_track_bytes(baked);
+        // Selector tracks are read with (int), they must not land on another integer
+        bool accepted = baked->max_error <= max_error && baked->int_mismatches == 0;
+        printf("Bake %-24s %6d samples %7d bytes error %.5f int %d%s\n",
+               var->name, baked->num_samples, bytes, baked->max_error, baked->int_mismatches,
+               accepted ? "" : " (kept exact)");
+        if (accepted) {
+            var->baked = baked;
+            total_bytes += bytes;
+        } else {
+            sync_free_baked_track(baked);
+            free(baked);
+        }
+    }
+    printf("Baked tracks use %d bytes at %d samples per row\n", total_bytes, samples_per_row);
+    rebuild_exact_tracks();
+#endif
+}
+
+RocketFrameStats get_rocket_frame_stats(void)
+{
+    return lastFrameStats;
 }
 
 void reset_rocket_device() {
     if (rocket_initialized == 1) {
+#ifdef SYNC_PLAYER
+        for (int i = 0; i < rocketVariableCount; i++) {
+            if (rocketVariables[i].baked) {
+                sync_free_baked_track(rocketVariables[i].baked);
+                free(rocketVariables[i].baked);
+                rocketVariables[i].baked = NULL;
+            }
+        }
+#endif
+        exactCount = 0;
         sync_destroy_device(rocket);
         rocket_initialized = 0;
     }
@@ -90,7 +305,17 @@ void set_RPB(double val) {
 
 void set_rocket_track_seconds(double elapsed_seconds)
 {
-    row = elapsed_seconds * row_rate;
+    elapsedSeconds = elapsed_seconds;
+    // A paused editor holds the row, playback continues from it
+    if (editorPaused) {
+        rowOffset = row - elapsed_seconds * row_rate;
+    }
+    row = elapsed_seconds * row_rate + rowOffset;
+}
+
+double get_rocket_track_row(void)
+{
+    return row;
 }
 
 float get_rocket_track_seconds(void)
@@ -1,22 +1,74 @@
 #ifndef ROCKET_CTOY_H
 #define ROCKET_CTOY_H
 
+#include <stdbool.h>
+
 /* Rocket */
 #define MAX_VARIABLES 512  // Adjust based on expected usage
 #define MAX_NAME_LENGTH 64 // Adjust based on expected name length
+#define DIRTY_MASK_WORDS ((MAX_VARIABLES + 31) / 32)
+
+// Player builds sample the tracks into lookup tables, 0 disables baking
+#ifndef ROCKET_BAKE_SAMPLES_PER_ROW
+#define ROCKET_BAKE_SAMPLES_PER_ROW 4
+#endif
+// Tracks that bake worse than this keep the exact evaluation, in the units of the track
+#ifndef ROCKET_BAKE_MAX_ERROR
+#define ROCKET_BAKE_MAX_ERROR 0.001f
+#endif
 
 // Structure to hold Rocket variable data
 typedef struct {
     char name[MAX_NAME_LENGTH];
     const struct sync_track* track;  // Store track pointer for efficient access
+    struct sync_baked_track* baked;  // Lookup table from rocket_bake_tracks or NULL
+    int segment;                     // Key segment at the last evaluated row, for the dirty mask
+    unsigned int edits;              // Key edits of the track seen by the last dirty mask
 } RocketVariable;
 
+// Counters of the previous frame
+typedef struct {
+    int evaluations; // Tracks interpolated by rocket_evaluate_frame
+    int reads;       // get_from_rocket calls, reads - evaluations were saved
+} RocketFrameStats;
+
 
 unsigned short add_to_rocket(const char *name);
 float get_from_rocket(unsigned short id);
+/**
+ * @brief Evaluate all tracks at row. Call once at the start of the frame,
+ * get_from_rocket returns these values until the next call.
+ */
+void rocket_evaluate_frame(double row);
+RocketFrameStats get_rocket_frame_stats(void);
+/**
+ * @brief Did the variable change between the previous and the current frame
+ */
+bool rocket_changed(unsigned short id);
+/**
+ * @brief Can the variable differ from its value at since_row, e.g. the row a mesh was built at
+ */
+bool rocket_changed_since(unsigned short id, double since_row);
+/**
+ * @brief Bit per variable, set when it changed between the previous and the current frame
+ */
+const unsigned int* get_rocket_dirty_mask(void);
+/**
+ * @brief Sample a variable at n rows around the current one, for per-instance delays
+ * @param row_offset First sample is at current row + row_offset
+ * @param row_step Rows between samples, negative to look back in time
+ * @param out n values
+ */
+void get_from_rocket_range(unsigned short id, float row_offset, float row_step, int n, float *out);
+/**
+ * @brief Bake all added tracks into lookup tables. Only in SYNC_PLAYER builds,
+ * call after the last add_to_rocket. Prints memory use and error per track.
+ */
+void rocket_bake_tracks(int samples_per_row, float max_error);
 void set_BPM(double val);
 void set_RPB(double val);
 float get_rocket_track_seconds(void);
+double get_rocket_track_row(void);
 void set_rocket_track_seconds(double elapsed_seconds);
 
 #endif
@@ -51,6 +51,12 @@ struct sync_sockio_cb {
 	 */
 	int (*poll)(void *ctxt, int *res_readable, int *res_writeable);
 
+	/* Block until ctxt is readable or timeout_ms passed, returns like
+	 * poll for readability. Optional, the editor thread falls back to
+	 * polling when it is NULL.
+	 */
+	int (*wait)(void *ctxt, int *res_readable, int timeout_ms);
+
 
 	/* Send len bytes via ctxt, returns:
 	 * -errno on error,
@@ -83,6 +89,16 @@ void sync_set_io_cb(struct sync_device *d, struct sync_io_cb *cb);
 
 const struct sync_track *sync_get_track(struct sync_device *, const char *);
 double sync_get_val(const struct sync_track *, double);
+double sync_get_val_cursor(const struct sync_track *, double, int *);
+/* Can the value differ between the rows? Decided from the key segments only,
+ * 0 means both rows are in the same KEY_STEP segment or outside the keys. */
+int sync_track_changed(const struct sync_track *, double row_a, double row_b);
+/* Sample one track at row0 + i * row_step for i < n, walking the keys once */
+void sync_get_val_range(const struct sync_track *, double row0, double row_step, int n, float *out);
+/* Evaluate n tracks at the same row in one pass, NULL tracks give 0.
+ * Interpolation runs in float, the cursor version keeps one cursor per track. */
+void sync_get_vals(const struct sync_track **tracks, int n, double row, float *out);
+void sync_get_vals_cursor(const struct sync_track **tracks, int n, double row, float *out, int *cursors);
 
 #ifdef __cplusplus
 }
@@ -98,27 +98,29 @@ static SOCKET server_connect(const char *host, unsigned short nport)
 	return sock;
 }
 
-static int sync_tcp_poll(void *ctxt, int *res_readable, int *res_writeable)
+static int tcp_poll(struct sync_tcp *tcp, int *res_readable, int *res_writeable,
+    int timeout_ms)
 {
-	struct sync_tcp *tcp = ctxt;
 #ifdef GEKKO
 	// libogc doesn't impmelent select()...
 	struct pollsd sds[1];
-	int events = (res_readable ? POLLIN : 0) | (res_writeable ? POLLOUT : 0)
+	int events = (res_readable ? POLLIN : 0) | (res_writeable ? POLLOUT : 0);
 	sds[0].socket  = tcp->sock;
 	sds[0].events  = events;
 	sds[0].revents = 0;
-	if (net_poll(sds, 1, 0) < 0) return 0;
+	if (net_poll(sds, 1, timeout_ms) < 0) return 0;
 	if (res_readable)
 		*res_readable = (sds[0].revents & POLLIN) && !(sds[0].revents & (POLLERR|POLLHUP|POLLNVAL));
 	if (res_writeable)
 		*res_writeable = (sds[0].revents & POLLOUT) && !(sds[0].revents & (POLLERR|POLLHUP|POLLNVAL));
 	return 1;
 #else
-	struct timeval to = { 0, 0 };
+	struct timeval to;
 	fd_set rfds, wfds;
 	int r;
 
+	to.tv_sec = timeout_ms / 1000;
+	to.tv_usec = (timeout_ms % 1000) * 1000;
 	FD_ZERO(&rfds);
 	FD_ZERO(&wfds);
 
@@ -146,6 +148,16 @@ static int sync_tcp_poll(void *ctxt, int *res_readable, int *res_writeable)
 #endif
 }
 
+static int sync_tcp_poll(void *ctxt, int *res_readable, int *res_writeable)
+{
+	return tcp_poll(ctxt, res_readable, res_writeable, 0);
+}
+
+static int sync_tcp_wait(void *ctxt, int *res_readable, int timeout_ms)
+{
+	return tcp_poll(ctxt, res_readable, NULL, timeout_ms);
+}
+
 static int sync_tcp_send(void *ctxt, const void *buf, int len)
 {
 	struct sync_tcp *tcp = ctxt;
@@ -180,6 +192,7 @@ static void sync_tcp_close(void *ctxt)
 
 static struct sync_sockio_cb sync_tcp_sockio = {
 	.poll = sync_tcp_poll,
+	.wait = sync_tcp_wait,
 	.send = sync_tcp_send,
 	.recv = sync_tcp_recv,
 	.close = sync_tcp_close,
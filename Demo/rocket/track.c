@@ -1,11 +1,20 @@
 #include <stdlib.h>
 #include <assert.h>
 #include <math.h>
+#include <string.h>
 
 #include "sync.h"
 #include "track.h"
 #include "base.h"
 
+#if defined(__SSE__) || defined(_M_X64)
+ #include <xmmintrin.h>
+ #define SYNC_USE_SSE
+#elif defined(__ARM_NEON)
+ #include <arm_neon.h>
+ #define SYNC_USE_NEON
+#endif
+
 static double key_linear(const struct track_key k[2], double row)
 {
 	double t = (row - k[0].row) / (k[1].row - k[0].row);
@@ -26,17 +35,8 @@ static double key_ramp(const struct track_key k[2], double row)
 	return k[0].value + (k[1].value - k[0].value) * t;
 }
 
-double sync_get_val(const struct sync_track *t, double row)
+static double get_val_at(const struct sync_track *t, int idx, double row)
 {
-	int idx, irow;
-
-	/* If we have no keys at all, return a constant 0 */
-	if (!t->num_keys)
-		return 0.0f;
-
-	irow = (int)floor(row);
-	idx = key_idx_floor(t, irow);
-
 	/* at the edges, return the first/last value */
 	if (idx < 0)
 		return t->keys[0].value;
@@ -59,6 +59,55 @@ double sync_get_val(const struct sync_track *t, double row)
 	}
 }
 
+double sync_get_val(const struct sync_track *t, double row)
+{
+	/* If we have no keys at all, return a constant 0 */
+	if (!t->num_keys)
+		return 0.0f;
+
+	return get_val_at(t, key_idx_floor(t, (int)floor(row)), row);
+}
+
+/* Check if the segment starting at key idx contains row.
+ * idx == -1 is the segment before the first key. */
+static inline int segment_contains(const struct sync_track *t, int idx, int row)
+{
+	if (idx < -1 || idx >= t->num_keys)
+		return 0;
+	if (idx >= 0 && t->keys[idx].row > row)
+		return 0;
+	if (idx + 1 < t->num_keys && t->keys[idx + 1].row <= row)
+		return 0;
+	return 1;
+}
+
+int sync_key_idx_cursor(const struct sync_track *t, int row, int *cursor)
+{
+	int idx = *cursor;
+
+	/* during playback the row stays in the same segment or moves into
+	 * a neighbour, only seeks need the binary search */
+	if (!segment_contains(t, idx, row)) {
+		if (segment_contains(t, idx + 1, row))
+			idx++;
+		else if (segment_contains(t, idx - 1, row))
+			idx--;
+		else
+			idx = key_idx_floor(t, row);
+	}
+
+	*cursor = idx;
+	return idx;
+}
+
+double sync_get_val_cursor(const struct sync_track *t, double row, int *cursor)
+{
+	if (!t->num_keys)
+		return 0.0f;
+
+	return get_val_at(t, sync_key_idx_cursor(t, (int)floor(row), cursor), row);
+}
+
 int sync_find_key(const struct sync_track *t, int row)
 {
 	int lo = 0, hi = t->num_keys;
@@ -81,41 +130,280 @@ int sync_find_key(const struct sync_track *t, int row)
 	return -lo - 1;
 }
 
+int sync_track_changed(const struct sync_track *t, double row_a, double row_b)
+{
+	int a, b;
+
+	if (row_a == row_b || !t->num_keys)
+		return 0;
+
+	a = key_idx_floor(t, (int)floor(row_a));
+	b = key_idx_floor(t, (int)floor(row_b));
+	return a != b || !sync_segment_is_constant(t, a);
+}
+
+void sync_get_val_range(const struct sync_track *t, double row0,
+    double row_step, int n, float *out)
+{
+	int i, cursor = -1;
+
+	for (i = 0; i < n; ++i) {
+		double row = row0 + row_step * i;
+		if (!t->num_keys)
+			out[i] = 0.0f;
+		else
+			out[i] = (float)get_val_at(t, sync_key_idx_cursor(t, (int)floor(row), &cursor), row);
+	}
+}
+
+/* Key types as the polynomial s(t) = t * (c1 + t * (c2 + t * c3)),
+ * so a batch of mixed types runs through the same arithmetic. */
+static const float key_poly[KEY_TYPE_COUNT][3] = {
+	{ 0.0f, 0.0f, 0.0f },  /* KEY_STEP */
+	{ 1.0f, 0.0f, 0.0f },  /* KEY_LINEAR */
+	{ 0.0f, 3.0f, -2.0f }, /* KEY_SMOOTH, t * t * (3 - 2 * t) */
+	{ 0.0f, 1.0f, 0.0f },  /* KEY_RAMP, t^2 */
+};
+
+#define SYNC_VALS_BATCH 64
+
+struct vals_batch {
+	float t[SYNC_VALS_BATCH];
+	float v0[SYNC_VALS_BATCH];
+	float dv[SYNC_VALS_BATCH];
+	float c1[SYNC_VALS_BATCH];
+	float c2[SYNC_VALS_BATCH];
+	float c3[SYNC_VALS_BATCH];
+	int slot[SYNC_VALS_BATCH]; /* index in out of each batch entry */
+};
+
+static void eval_batch(const struct vals_batch *b, float *out, int n)
+{
+	int i = 0;
+#if defined(SYNC_USE_SSE)
+	for (; i + 4 <= n; i += 4) {
+		__m128 t = _mm_loadu_ps(b->t + i);
+		__m128 s = _mm_add_ps(_mm_loadu_ps(b->c2 + i), _mm_mul_ps(t, _mm_loadu_ps(b->c3 + i)));
+		s = _mm_add_ps(_mm_loadu_ps(b->c1 + i), _mm_mul_ps(t, s));
+		s = _mm_mul_ps(t, s);
+		_mm_storeu_ps(out + i, _mm_add_ps(_mm_loadu_ps(b->v0 + i), _mm_mul_ps(_mm_loadu_ps(b->dv + i), s)));
+	}
+#elif defined(SYNC_USE_NEON)
+	for (; i + 4 <= n; i += 4) {
+		float32x4_t t = vld1q_f32(b->t + i);
+		float32x4_t s = vmlaq_f32(vld1q_f32(b->c2 + i), t, vld1q_f32(b->c3 + i));
+		s = vmlaq_f32(vld1q_f32(b->c1 + i), t, s);
+		s = vmulq_f32(t, s);
+		vst1q_f32(out + i, vmlaq_f32(vld1q_f32(b->v0 + i), vld1q_f32(b->dv + i), s));
+	}
+#endif
+	for (; i < n; ++i) {
+		float t = b->t[i];
+		out[i] = b->v0[i] + b->dv[i] * (t * (b->c1[i] + t * (b->c2[i] + t * b->c3[i])));
+	}
+}
+
+/* Find the segments one track at a time. Tracks that hold a value (no keys,
+ * before the first or after the last key, step keys) are written directly,
+ * only the interpolating ones are gathered into the batch. */
+static void get_vals(const struct sync_track **tracks, int n, double row,
+    float *out, int *cursors)
+{
+	struct vals_batch b;
+	float values[SYNC_VALS_BATCH];
+	int irow = (int)floor(row);
+	int start, i, count = 0;
+
+	for (start = 0; start < n; ++start) {
+		const struct sync_track *t = tracks[start];
+		const struct track_key *k;
+		const float *poly;
+		int idx;
+
+		if (!t || !t->num_keys) {
+			out[start] = 0.0f;
+			continue;
+		}
+		idx = cursors ? sync_key_idx_cursor(t, irow, cursors + start) :
+		    key_idx_floor(t, irow);
+		if (idx < 0) {
+			out[start] = t->keys[0].value;
+			continue;
+		}
+		if (idx > t->num_keys - 2) {
+			out[start] = t->keys[t->num_keys - 1].value;
+			continue;
+		}
+		k = t->keys + idx;
+		if (k[0].type == KEY_STEP) {
+			out[start] = k[0].value;
+			continue;
+		}
+
+		assert(k[0].type < KEY_TYPE_COUNT);
+		poly = key_poly[k[0].type];
+		b.t[count] = (float)((row - k[0].row) / (k[1].row - k[0].row));
+		b.v0[count] = k[0].value;
+		b.dv[count] = k[1].value - k[0].value;
+		b.c1[count] = poly[0];
+		b.c2[count] = poly[1];
+		b.c3[count] = poly[2];
+		b.slot[count] = start;
+		if (++count == SYNC_VALS_BATCH) {
+			eval_batch(&b, values, count);
+			for (i = 0; i < count; ++i)
+				out[b.slot[i]] = values[i];
+			count = 0;
+		}
+	}
+	if (count) {
+		eval_batch(&b, values, count);
+		for (i = 0; i < count; ++i)
+			out[b.slot[i]] = values[i];
+	}
+}
+
+void sync_get_vals(const struct sync_track **tracks, int n, double row, float *out)
+{
+	get_vals(tracks, n, row, out, NULL);
+}
+
+void sync_get_vals_cursor(const struct sync_track **tracks, int n, double row,
+    float *out, int *cursors)
+{
+	get_vals(tracks, n, row, out, cursors);
+}
+
+#ifdef SYNC_PLAYER
+static inline double baked_sample(const struct sync_baked_track *b, int i)
+{
+	return b->min + b->samples[i] * b->scale;
+}
+
+double sync_get_baked_val(const struct sync_baked_track *b, double row)
+{
+	double pos = (row - b->first_row) * b->samples_per_row;
+	int i;
+
+	if (pos <= 0.0)
+		return baked_sample(b, 0);
+	if (pos >= b->num_samples - 1)
+		return baked_sample(b, b->num_samples - 1);
+
+	i = (int)pos;
+	if (b->hold[i >> 3] & (1 << (i & 7)))
+		return baked_sample(b, i);
+
+	return b->min + (b->samples[i] + (b->samples[i + 1] - b->samples[i]) * (pos - i)) * b->scale;
+}
+
+int sync_bake_track(const struct sync_track *t, int samples_per_row,
+    struct sync_baked_track *b)
+{
+	float *values;
+	float max;
+	int i, integral, cursor = -1;
+
+	memset(b, 0, sizeof(*b));
+	if (!t->num_keys || samples_per_row < 1)
+		return -1;
+
+	b->first_row = t->keys[0].row;
+	b->samples_per_row = samples_per_row;
+	b->num_samples = (t->keys[t->num_keys - 1].row - b->first_row) * samples_per_row + 1;
+
+	values = malloc(sizeof(float) * b->num_samples);
+	b->samples = malloc(sizeof(b->samples[0]) * b->num_samples);
+	b->hold = calloc((b->num_samples + 7) / 8, 1);
+	if (!values || !b->samples || !b->hold) {
+		free(values);
+		sync_free_baked_track(b);
+		return -1;
+	}
+
+	/* sample the exact curve, keys fall on samples as rows are integers */
+	b->min = max = t->keys[0].value;
+	for (i = 0; i < b->num_samples; ++i) {
+		double row = b->first_row + (double)i / samples_per_row;
+		int idx = sync_key_idx_cursor(t, (int)floor(row), &cursor);
+		values[i] = (float)sync_get_val_cursor(t, row, &cursor);
+		if (idx >= 0 && t->keys[idx].type == KEY_STEP)
+			b->hold[i >> 3] |= 1 << (i & 7);
+		if (values[i] < b->min)
+			b->min = values[i];
+		if (values[i] > max)
+			max = values[i];
+	}
+
+	/* a power of two step from a min on that step keeps integers and other
+	 * multiples of the step exact, held selector values must not drift */
+	if (max > b->min) {
+		b->scale = ldexpf(1.0f, ilogbf((max - b->min) / 65534.0f) + 1);
+		b->min = floorf(b->min / b->scale) * b->scale;
+	}
+	for (i = 0; i < b->num_samples; ++i)
+		b->samples[i] = b->scale > 0.0f ?
+		    (unsigned short)((values[i] - b->min) / b->scale + 0.5f) : 0;
+	free(values);
+
+	/* measure between the samples where smooth and ramp keys bend */
+	integral = sync_track_is_integral(t);
+	cursor = -1;
+	for (i = 0; i < b->num_samples * 4; ++i) {
+		double row = b->first_row + (double)i / (samples_per_row * 4);
+		float baked = (float)sync_get_baked_val(b, row);
+		float exact = (float)sync_get_val_cursor(t, row, &cursor);
+		if (fabsf(baked - exact) > b->max_error)
+			b->max_error = fabsf(baked - exact);
+		if (integral && (int)baked != (int)exact)
+			b->int_mismatches++;
+	}
+	return 0;
+}
+
+void sync_free_baked_track(struct sync_baked_track *b)
+{
+	free(b->samples);
+	free(b->hold);
+	b->samples = NULL;
+	b->hold = NULL;
+	b->num_samples = 0;
+}
+#endif /* defined(SYNC_PLAYER) */
+
 #ifndef SYNC_PLAYER
 int sync_set_key(struct sync_track *t, const struct track_key *k)
 {
 	int idx = sync_find_key(t, k->row);
 	if (idx < 0) {
-		/* no exact hit, we need to allocate a new key */
-		void *tmp;
+		/* no exact hit, we need room for a new key */
 		idx = -idx - 1;
-		tmp = realloc(t->keys, sizeof(struct track_key) *
-		    (t->num_keys + 1));
-		if (!tmp)
-			return -1;
+		if (t->num_keys == t->max_keys) {
+			int max_keys = t->max_keys ? t->max_keys * 2 : 16;
+			void *tmp = realloc(t->keys, sizeof(struct track_key) * max_keys);
+			if (!tmp)
+				return -1;
+			t->keys = tmp;
+			t->max_keys = max_keys;
+		}
 		t->num_keys++;
-		t->keys = tmp;
 		memmove(t->keys + idx + 1, t->keys + idx,
 		    sizeof(struct track_key) * (t->num_keys - idx - 1));
 	}
 	t->keys[idx] = *k;
+	t->edits++;
 	return 0;
 }
 
 int sync_del_key(struct sync_track *t, int pos)
 {
-	void *tmp;
 	int idx = sync_find_key(t, pos);
 	assert(idx >= 0);
+	/* keep the allocation, the editor is likely to add keys again */
 	memmove(t->keys + idx, t->keys + idx + 1,
 	    sizeof(struct track_key) * (t->num_keys - idx - 1));
-	assert(t->keys);
-	tmp = realloc(t->keys, sizeof(struct track_key) *
-	    (t->num_keys - 1));
-	if (t->num_keys != 1 && !tmp)
-		return -1;
 	t->num_keys--;
-	t->keys = tmp;
+	t->edits++;
 	return 0;
 }
 #endif
@@ -32,6 +32,8 @@ struct sync_track {
 	char *name;
 	struct track_key *keys;
 	int num_keys;
+	int max_keys; /* allocated keys, grows by doubling in sync_set_key */
+	unsigned int edits; /* bumped by every key change from the editor */
 };
 
 int sync_find_key(const struct sync_track *, int);
@@ -43,6 +45,50 @@ static inline int key_idx_floor(const struct sync_track *t, int row)
 	return idx;
 }
 
+/* Same as key_idx_floor, but starts from the segment cached in cursor.
+ * Sequential rows cost O(1), seeks fall back to the binary search. */
+int sync_key_idx_cursor(const struct sync_track *, int, int *);
+
+/* Are all key values integers, like the scene and index tracks the demo reads with (int) */
+static inline int sync_track_is_integral(const struct sync_track *t)
+{
+	int i;
+	for (i = 0; i < t->num_keys; ++i)
+		if (t->keys[i].value != (float)(int)t->keys[i].value)
+			return 0;
+	return 1;
+}
+
+/* Does the value stay the same across the whole segment starting at key idx */
+static inline int sync_segment_is_constant(const struct sync_track *t, int idx)
+{
+	return idx < 0 || idx >= t->num_keys - 1 || t->keys[idx].type == KEY_STEP;
+}
+
+#ifdef SYNC_PLAYER
+/* Track sampled at a fixed sub-row resolution, played back with lerp only.
+ * Values are quantized to 16 bits between min and min + 65535 * scale,
+ * scale is a power of two so that integer values stay exact. */
+struct sync_baked_track {
+	int first_row;       /* row of samples[0], the first key */
+	int samples_per_row;
+	int num_samples;
+	float min, scale;
+	unsigned short *samples;
+	unsigned char *hold; /* bit per sample: keep the value until the next one (KEY_STEP) */
+	float max_error;     /* largest difference to sync_get_val seen while baking */
+	int int_mismatches;  /* integral tracks: samples where (int) of the value differs from sync_get_val */
+};
+
+int sync_bake_track(const struct sync_track *, int samples_per_row, struct sync_baked_track *);
+void sync_free_baked_track(struct sync_baked_track *);
+double sync_get_baked_val(const struct sync_baked_track *, double);
+static inline int sync_baked_track_bytes(const struct sync_baked_track *b)
+{
+	return b->num_samples * (int)sizeof(b->samples[0]) + (b->num_samples + 7) / 8;
+}
+#endif /* defined(SYNC_PLAYER) */
+
 MRAPI void start_save_sync(const char *filename);
 MRAPI void save_sync(const struct sync_track *t, const char *filename);
 MRAPI void end_save_sync(const char *filename);
@@ -1,5 +1,6 @@
 #include "color_manager.h"
 #include <stdlib.h>
+#include <string.h>
 
 #define RED(c)		(((c)>>24)&0xFF)	/*!< Gets the red component intensity from a 32-bit color value.
 										 *	 \param[in] c 32-bit RGBA color value
@@ -70,6 +71,19 @@ color3 ColorManager_HexToColor(unsigned int hex)
     return c;
 }
 
+unsigned int ColorManager_ToRGBA8(color3 color)
+{
+    unsigned char rgba[4] = {
+        (unsigned char)(M_CLAMP(color.r, 0.0f, 1.0f) * 255.0f),
+        (unsigned char)(M_CLAMP(color.g, 0.0f, 1.0f) * 255.0f),
+        (unsigned char)(M_CLAMP(color.b, 0.0f, 1.0f) * 255.0f),
+        255
+    };
+    unsigned int packed;
+    memcpy(&packed, rgba, sizeof(packed));
+    return packed;
+}
+
 #undef RED
 #undef GREEN
 #undef BLUE
@@ -33,4 +33,9 @@ color3* ColorManager_Get(short index);
 color3* ColorManager_GetName(enum ColorName name);
 color3 ColorManager_HexToColor(unsigned int hex);
 
+/**
+ * @brief Color as the bytes R, G, B, 255 in memory order, for GL_UNSIGNED_BYTE color arrays
+ */
+unsigned int ColorManager_ToRGBA8(color3 color);
+
 #endif
@@ -2,11 +2,75 @@
 #define FLAKE_WHEEL_FX_C
 
 #include <math.h>
+#include <stdbool.h>
 #include <opengl_include.h>
+#include "flake_wheel_fx.h"
 #include "koch_flake.h"
 #include "gradient.h"
 #include "../Ziz/screenprint.h"
 
+// Corners of a hexagon with radius 1 and no rotation
+static float2 unit_hexagon[6];
+static bool unit_hexagon_ready = false;
+
+void FlakeWheel_HexagonCorners(float radius, float angle, float2* points)
+{
+    if (!unit_hexagon_ready)
+    {
+        float2 zero2 = {0.0f, 0.0f};
+        get_corners(zero2, 6, 1.0f, 0.0f, unit_hexagon);
+        unit_hexagon_ready = true;
+    }
+    // Rotating the whole hexagon is the same as starting each corner from the angle
+    const float radians = angle * M_DEG_TO_RAD;
+    const float c = cosf(radians) * radius;
+    const float s = sinf(radians) * radius;
+    for (short i = 0; i < 6; i++)
+    {
+        points[i].x = unit_hexagon[i].x * c - unit_hexagon[i].y * s;
+        points[i].y = unit_hexagon[i].x * s + unit_hexagon[i].y * c;
+    }
+}
+
+void FlakeWheel_Build(struct FlakeWheel* wheel,
+                      float pattern_radius,
+                      float pattern_radius_outer,
+                      float shape_rotation_deg,
+                      float pattern_rotation_deg,
+                      float pattern_rotation_deg_outer,
+                      struct Gradient* gradient,
+                      float base_color_stop,
+                      float ring_color_offset,
+                      float shape_color_offset)
+{
+    // Every ring is the same hexagon moved to a corner of the pattern
+    float2 ring_centers[FLAKE_WHEEL_RINGS];
+    float2 hexpoints[6];
+    FlakeWheel_HexagonCorners(pattern_radius, pattern_rotation_deg, ring_centers);
+    FlakeWheel_HexagonCorners(pattern_radius_outer, pattern_rotation_deg_outer, hexpoints);
+
+    float shape_rotation[6];
+    Mesh_SetTransform2D(shape_rotation, 0.0f, 0.0f, shape_rotation_deg, 1.0f);
+
+    float color_stops[FLAKE_WHEEL_SHAPES];
+    for (int i = 0; i < FLAKE_WHEEL_RINGS; i++)
+    {
+        for (int p = 0; p < 6; p++)
+        {
+            const int shape = i * 6 + p;
+            float* transform = &wheel->transforms[shape * 6];
+            transform[0] = shape_rotation[0];
+            transform[1] = shape_rotation[1];
+            transform[2] = shape_rotation[2];
+            transform[3] = shape_rotation[3];
+            transform[4] = ring_centers[i].x + hexpoints[p].x;
+            transform[5] = ring_centers[i].y + hexpoints[p].y;
+            color_stops[shape] = base_color_stop + ring_color_offset * i + shape_color_offset * p;
+        }
+    }
+    Gradient_GetColors(gradient, color_stops, FLAKE_WHEEL_SHAPES, wheel->colors);
+}
+
 void flake_wheel_fx(struct Mesh* flake,
                     float pattern_radius,
                     float pattern_radius_outer,
@@ -19,30 +83,18 @@ void flake_wheel_fx(struct Mesh* flake,
                     float shape_color_offset
                     )
 {
-    float2 zero2 = {0.0f, 0.0f};
-    short recursion = 2;
-    float2 cornerlist[6];
-    get_corners(zero2, 6, pattern_radius, pattern_rotation_deg, cornerlist);
-    //screenprintf("%.1f, %.1f\n", center.x, center.y);
-    for (int i = 0; i < 6; i++)
-    {
-        float2 hexpoints[6];
-        get_corners(cornerlist[i], 6, pattern_radius_outer, pattern_rotation_deg_outer, hexpoints);
-        for (int p = 0; p < 6; p++)
-        {
-            glPushMatrix();
-                glTranslatef(
-                    hexpoints[p].x,
-                    hexpoints[p].y,
-                    0.0f);
-                glRotatef(shape_rotation_deg, 0.0f, 0.0f, 1.0f);
-                //glScalef(pattern_radius/6.0f, pattern_radius/6.0f, 1.0f);
-                Gradient_glColor(gradient, base_color_stop + ring_color_offset * i + shape_color_offset * p);
-                Mesh_Draw(flake, DrawTriangles);
-            glPopMatrix();
-        }
-
-    }
+    static struct FlakeWheel wheel;
+    FlakeWheel_Build(&wheel,
+                     pattern_radius,
+                     pattern_radius_outer,
+                     shape_rotation_deg,
+                     pattern_rotation_deg,
+                     pattern_rotation_deg_outer,
+                     gradient,
+                     base_color_stop,
+                     ring_color_offset,
+                     shape_color_offset);
+    Mesh_DrawInstances(flake, wheel.transforms, wheel.colors, FLAKE_WHEEL_SHAPES);
 }
 
 #endif
@@ -5,6 +5,36 @@
 #include "koch_flake.h"
 #include "../Ziz/mesh.h"
 
+// 6 hexagons of 6 flakes
+#define FLAKE_WHEEL_RINGS 6
+#define FLAKE_WHEEL_SHAPES (FLAKE_WHEEL_RINGS * 6)
+
+/**
+ * @brief Placements and colors of every flake of the wheel, ready for Mesh_DrawInstances
+ */
+struct FlakeWheel
+{
+    float transforms[FLAKE_WHEEL_SHAPES * 6];
+    color3 colors[FLAKE_WHEEL_SHAPES];
+};
+
+/**
+ * @brief Corners of a hexagon around origin, same as get_corners with 6 corners
+ * but rotated from a cached unit hexagon
+ */
+void FlakeWheel_HexagonCorners(float radius, float angle, float2* points);
+
+void FlakeWheel_Build(struct FlakeWheel* wheel,
+                      float pattern_radius,
+                      float pattern_radius_outer,
+                      float shape_rotation_deg,
+                      float pattern_rotation_deg,
+                      float pattern_rotation_deg_outer,
+                      struct Gradient* gradient,
+                      float base_color_stop,
+                      float ring_color_offset,
+                      float shape_color_offset);
+
 void flake_wheel_fx(struct Mesh* flake,
                     float pattern_radius,
                     float pattern_radius_outer,
@@ -1,192 +1,377 @@
 #include "gosper_curve.h"
 #include <m_float2_math.h>
 #include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <limits.h>
 #include <opengl_include.h>
+#include <wii_memory_functions.h>
 #include "../Ziz/screenprint.h"
 
-static float2 latest; // Middle point of the path
-static float2 direction;
-static float2 to_right;
-static float2 left; // Left side of path
-static float2 right; // Right side of path
-static float step;
-static float half_width;
 static const float radians = 60.0f * M_DEG_TO_RAD;
 
-static void Gosper_Turn(float sign, struct PointList* points)
+// Productions of the L-system, '+' and '-' turn and the letters recurse
+static const char production_a[] = "A-B--B+A++AA+B-";
+static const char production_b[] = "+A-BB--B-A++A+B";
+#define GOSPER_PRODUCTION_LENGTH 15
+
+/**
+ * @brief Make room for the two points of the next step of the path
+ * @return False if the allocation failed
+ */
+static bool Gosper_Reserve(struct GosperCurve* curve)
+{
+    if (curve->point_count + 2 > curve->allocated_size)
+    {
+        int new_size = curve->allocated_size > 0 ? curve->allocated_size * 2 : 256;
+        float2* base = (float2*)realloc(curve->base, sizeof(float2) * new_size);
+        if (base == NULL)
+        {
+            printf("Gosper curve points not allocated!\n");
+            return false;
+        }
+        curve->base = base;
+        float2* offset = (float2*)realloc(curve->offset, sizeof(float2) * new_size);
+        if (offset == NULL)
+        {
+            printf("Gosper curve points not allocated!\n");
+            return false;
+        }
+        curve->offset = offset;
+        curve->allocated_size = new_size;
+    }
+    return true;
+}
+
+// Room must have been made with Gosper_Reserve
+static void Gosper_Push(struct GosperCurve* curve, struct GosperPoint point)
 {
+    curve->base[curve->point_count] = point.base;
+    curve->offset[curve->point_count] = point.offset;
+    curve->point_count++;
+}
+
+static bool Gosper_Turn(struct GosperCurve* curve, float sign)
+{
+    if (!Gosper_Reserve(curve))
+    {
+        return false;
+    }
     // Rotate direction
-    M_ROTATE2_PTR(&direction, sign * radians);
+    M_ROTATE2_PTR(&curve->direction, sign * radians);
     // calculate right
-    M_RIGHT_ANGLE2(to_right, direction);
-    M_SCALE2(to_right, to_right, (half_width));
+    M_RIGHT_ANGLE2(curve->to_right, curve->direction);
 
     // store left or right depending on sign
     // store new point as left or right
     // and update middle point
     if (sign > 0)
     {
-        PointList_push_point(points, left);
-        M_ADD2(latest, left, to_right);
-        M_ADD2(right, latest, to_right);
-        PointList_push_point(points, right);
+        Gosper_Push(curve, curve->left);
+        curve->latest.base = curve->left.base;
+        M_ADD2(curve->latest.offset, curve->left.offset, curve->to_right);
+        curve->right.base = curve->latest.base;
+        M_ADD2(curve->right.offset, curve->latest.offset, curve->to_right);
+        Gosper_Push(curve, curve->right);
     }
     else
     {
-        M_SUB2(latest, right, to_right);
-        M_SUB2(left, latest, to_right);
-        PointList_push_point(points, left);
-        PointList_push_point(points, right);
+        curve->latest.base = curve->right.base;
+        M_SUB2(curve->latest.offset, curve->right.offset, curve->to_right);
+        curve->left.base = curve->latest.base;
+        M_SUB2(curve->left.offset, curve->latest.offset, curve->to_right);
+        Gosper_Push(curve, curve->left);
+        Gosper_Push(curve, curve->right);
     }
+    return true;
 }
 
-
-void Gosper_Move(struct PointList* points)
+static bool Gosper_Move(struct GosperCurve* curve)
 {
+    if (!Gosper_Reserve(curve))
+    {
+        return false;
+    }
     float2 next;
-    M_SCALE2(next, direction, step);
-    M_ADD2(next, next, latest);
-    latest = next;
-    M_SUB2(left, next, to_right);
-    M_ADD2(right, next, to_right);
+    M_SCALE2(next, curve->direction, curve->step);
+    M_ADD2(curve->latest.base, curve->latest.base, next);
+    curve->left.base = curve->latest.base;
+    M_SUB2(curve->left.offset, curve->latest.offset, curve->to_right);
+    curve->right.base = curve->latest.base;
+    M_ADD2(curve->right.offset, curve->latest.offset, curve->to_right);
 
-    PointList_push_point(points, left);
-    PointList_push_point(points, right);
+    Gosper_Push(curve, curve->left);
+    Gosper_Push(curve, curve->right);
+    return true;
+}
 
-    //printf("Added %.2f, %.2f\n", latest.x, latest.y);
+static void Gosper_Enter(struct GosperCurve* curve, char symbol, short level)
+{
+    struct GosperFrame* frame = &curve->stack[curve->stack_size++];
+    frame->symbol = symbol;
+    frame->level = level;
+    frame->next = 0;
 }
 
-void Gosper_A(struct PointList* points, short recursion_level)
+/**
+ * @brief Walk the L-system until the curve has point_count points or ends.
+ * Same order as recursing into A and B, with the recursion kept in curve->stack.
+ * @return False if the points could not be allocated, the curve then ends where it is
+ */
+static bool Gosper_Walk(struct GosperCurve* curve, int point_count)
 {
-    if (recursion_level <= 0)
+    while (curve->stack_size > 0 && curve->point_count < point_count)
     {
-        Gosper_Move(points);
-        return;
+        struct GosperFrame* frame = &curve->stack[curve->stack_size - 1];
+        bool pushed = true;
+        if (frame->level <= 0)
+        {
+            pushed = Gosper_Move(curve);
+            curve->stack_size--;
+        }
+        else if (frame->next >= GOSPER_PRODUCTION_LENGTH)
+        {
+            curve->stack_size--;
+        }
+        else
+        {
+            const char* production = frame->symbol == 'A' ? production_a : production_b;
+            const char token = production[frame->next++];
+            if (token == '+')
+            {
+                pushed = Gosper_Turn(curve, 1.0f);
+            }
+            else if (token == '-')
+            {
+                pushed = Gosper_Turn(curve, -1.0f);
+            }
+            else
+            {
+                Gosper_Enter(curve, token, frame->level - 1);
+            }
+        }
+        if (!pushed)
+        {
+            curve->stack_size = 0;
+            return false;
+        }
     }
+    return true;
+}
 
-    const short next_recursion = recursion_level - 1;
-    Gosper_A(points, next_recursion);
-    Gosper_Turn(-1.0f, points);
-    Gosper_B(points, next_recursion);
-    Gosper_Turn(-1.0f, points);
-    Gosper_Turn(-1.0f, points);
-    Gosper_B(points, next_recursion);
-    Gosper_Turn(1.0f, points);
-    Gosper_A(points, next_recursion);
-    Gosper_Turn(1.0f, points);
-    Gosper_Turn(1.0f, points);
-    Gosper_A(points, next_recursion);
-    Gosper_A(points, next_recursion);
-    Gosper_Turn(1.0f, points);
-    Gosper_B(points, next_recursion);
-    Gosper_Turn(-1.0f, points);
+struct GosperCurve GosperCurve_CreateEmpty(void)
+{
+    struct GosperCurve curve;
+    memset(&curve, 0, sizeof(curve));
+    curve.recursion_level = -1;
+    return curve;
 }
 
-void Gosper_B(struct PointList* points, short recursion_level)
+void GosperCurve_Build(struct GosperCurve* curve, float2 start, float2 start_dir, float step_length, short recursion_level)
 {
-    if (recursion_level <= 0)
+    if (recursion_level > GOSPER_MAX_RECURSION)
+    {
+        printf("Gosper recursion %d over max %d\n", recursion_level, GOSPER_MAX_RECURSION);
+        recursion_level = GOSPER_MAX_RECURSION;
+    }
+    if (curve->recursion_level == recursion_level
+        && curve->step == step_length
+        && curve->start.x == start.x && curve->start.y == start.y
+        && curve->start_dir.x == start_dir.x && curve->start_dir.y == start_dir.y)
     {
-        Gosper_Move(points);
         return;
     }
+    curve->recursion_level = recursion_level;
+    curve->start = start;
+    curve->start_dir = start_dir;
+    curve->step = step_length;
+    curve->point_count = 0;
 
-    const short next_recursion = recursion_level - 1;
-    Gosper_Turn(1.0f, points);
-    Gosper_A(points, next_recursion);
-    Gosper_Turn(-1.0f, points);
-    Gosper_B(points, next_recursion);
-    Gosper_B(points, next_recursion);
-    Gosper_Turn(-1.0f, points);
-    Gosper_Turn(-1.0f, points);
-    Gosper_B(points, next_recursion);
-    Gosper_Turn(-1.0f, points);
-    Gosper_A(points, next_recursion);
-    Gosper_Turn(1.0f, points);
-    Gosper_Turn(1.0f, points);
-    Gosper_A(points, next_recursion);
-    Gosper_Turn(1.0f, points);
-    Gosper_B(points, next_recursion);
+    curve->direction = start_dir;
+    M_RIGHT_ANGLE2(curve->to_right, curve->direction);
+    curve->latest.base = start;
+    curve->latest.offset.x = 0.0f;
+    curve->latest.offset.y = 0.0f;
+
+    curve->left.base = start;
+    M_SUB2(curve->left.offset, curve->latest.offset, curve->to_right);
+    curve->right.base = start;
+    M_ADD2(curve->right.offset, curve->latest.offset, curve->to_right);
+    curve->stack_size = 0;
+    if (!Gosper_Reserve(curve))
+    {
+        return;
+    }
+    Gosper_Push(curve, curve->left);
+    Gosper_Push(curve, curve->right);
+    Gosper_Enter(curve, 'A', recursion_level);
+}
+
+int GosperCurve_Extend(struct GosperCurve* curve, float segments)
+{
+    // Gosper_Draw reads one pair past the last full segment
+    const int needed = (int)floorf(M_MAX(segments, 0.0f)) * 2 + 2;
+    if (!Gosper_Walk(curve, needed))
+    {
+        printf("Gosper curve stopped at %d points\n", curve->point_count);
+    }
+    return curve->point_count;
 }
 
+void GosperCurve_ApplyWidth(const struct GosperCurve* curve, float path_width, struct PointList* points, int first)
+{
+    // Without room for the whole curve, the points that fit
+    PointList_reserve(points, curve->point_count);
+    const int point_count = M_MIN(curve->point_count, points->allocated_size);
+    const float half_width = path_width / 2.0f;
+    // Same operation on every float, the compiler can vectorize this
+    const int count = point_count * 2;
+    const float* restrict base = (const float*)curve->base;
+    const float* restrict offset = (const float*)curve->offset;
+    float* restrict out = (float*)points->points;
+    for (int i = first * 2; i < count; i++)
+    {
+        out[i] = base[i] + offset[i] * half_width;
+    }
+    points->used_size = point_count;
+}
 
+void GosperCurve_Free(struct GosperCurve* curve)
+{
+    free(curve->base);
+    free(curve->offset);
+    *curve = GosperCurve_CreateEmpty();
+}
 
 void Gosper_Create(struct PointList* points, float2 start, float2 start_dir, float step_length, float path_width, short recursion_level)
 {
-    PointList_clear(points);
-    latest = start;
-    direction = start_dir;
-    step = step_length;
-    half_width = path_width / 2.0f;
-    M_RIGHT_ANGLE2(to_right, direction);
-    M_SCALE2(to_right, to_right, half_width);
-
-    M_SUB2(left, latest, to_right);
-    M_ADD2(right, latest, to_right);
-    PointList_push_point(points, left);
-    PointList_push_point(points, right);
+    struct GosperCurve curve = GosperCurve_CreateEmpty();
+    GosperCurve_Build(&curve, start, start_dir, step_length, recursion_level);
+    Gosper_Walk(&curve, INT_MAX);
+    GosperCurve_ApplyWidth(&curve, path_width, points, 0);
+    GosperCurve_Free(&curve);
+}
 
-    Gosper_A(points, recursion_level);
-    //printf("Created gosper curve with %d points\n", points->used_size);
+struct GosperStrip GosperStrip_CreateEmpty(void)
+{
+    struct GosperStrip strip;
+    memset(&strip, 0, sizeof(strip));
+    return strip;
 }
 
-float2 Gosper_Draw(struct PointList* list, struct Gradient* gradient, float amount, float gradient_offset, float gradient_step_prct)
+float2 GosperStrip_Prepare(struct GosperStrip* strip, struct PointList* list, struct Gradient* gradient, float amount, float gradient_offset, float gradient_step_prct)
 {
-    // TODO use quads
-    // store to list when there is a turn
-    // or store left and right vertex to list
-    float2 left;
-    float2 right;
-    glBegin(GL_QUAD_STRIP);
     // Last is always odd number
     int last_index = M_MIN( list->used_size, (int)floor(amount) * 2 -1);
+    const int pairs = M_MAX(0, (last_index + 1) / 2);
+    strip->vertex_count = pairs * 2;
+
+    if (strip->vertex_count > strip->color_capacity)
+    {
+        free(strip->colors);
+        strip->colors = (unsigned int*)AllocateGPUMemory(sizeof(unsigned int) * strip->vertex_count);
+        strip->color_capacity = strip->colors != NULL ? strip->vertex_count : 0;
+        if (strip->colors == NULL)
+        {
+            // Only the partial end is drawn
+            printf("Gosper strip colors not allocated!\n");
+            strip->vertex_count = 0;
+        }
+    }
+
+    // Both sides of a segment have the same color
     float gradient_step = gradient_step_prct / 100.0f;
-    float gradient_stop = gradient_offset;
+    float segment_stops[64];
+    color3 segment_colors[64];
+    const int color_pairs = strip->vertex_count / 2;
+    for (int first = 0; first < color_pairs; first += 64)
+    {
+        const int count = M_MIN(64, color_pairs - first);
+        for (int i = 0; i < count; i++)
+        {
+            segment_stops[i] = gradient_offset + gradient_step * (first + i);
+        }
+        Gradient_GetColors(gradient, segment_stops, count, segment_colors);
+        for (int i = 0; i < count; i++)
+        {
+            const unsigned int color = ColorManager_ToRGBA8(segment_colors[i]);
+            strip->colors[(first + i) * 2] = color;
+            strip->colors[(first + i) * 2 + 1] = color;
+        }
+    }
+    // The partial end keeps the color of the last full segment
+    const unsigned int tail_color = strip->vertex_count > 0
+        ? strip->colors[strip->vertex_count - 1]
+        : ColorManager_ToRGBA8(Gradient_GetColor(gradient, gradient_offset));
+    if (strip->vertex_count > 0)
+    {
+        FlushGPUCache(strip->colors, sizeof(unsigned int) * strip->vertex_count);
+    }
 
-    for(int i = 0; i < last_index; i += 2)
+    float2 left = list->points[0];
+    float2 right = list->points[1];
+    if (pairs > 0)
     {
-        left = list->points[i];
-        right = list->points[i+1];
-        Gradient_glColor(gradient, gradient_stop);
-        glVertex2f(left.x, left.y);
-        glVertex2f(right.x, right.y);
-        gradient_stop += gradient_step;
+        left = list->points[pairs * 2 - 2];
+        right = list->points[pairs * 2 - 1];
     }
 
     // Draw last partial segment
     int end_point_left = M_MIN( list->used_size-2, last_index+1);
     int end_point_right = M_MIN( list->used_size-1, last_index+2);
 
-    screenprintf("Last index %d", last_index);
-    screenprintf("Last is %d/%d Amount %.2f\n", end_point_left, end_point_right, amount);
-
     float2 last_left = list->points[end_point_left];
     float2 last_right = list->points[end_point_right];
     if (last_index < list->used_size-1)
     {
-        float partial = 1.0f;
-        partial = amount - floor(amount);
-        screenprintf("Partial %.2f\n", partial);
+        float partial = amount - floor(amount);
         float2 dir;
         M_SUB2(dir, last_left, left);
         dir.x = dir.x*partial;
         dir.y = dir.y*partial;
-        screenprintf("dir is %.2f/%.2f\n", dir.x, dir.y);
-        //M_NORMALIZE2(dir, dir);
-        //M_SCALE2(dir, dir, partial * step);
         M_ADD2(last_left, left, dir);
         M_ADD2(last_right, right, dir);
     }
-    glVertex2f(last_left.x, last_left.y);
-    glVertex2f(last_right.x, last_right.y);
-
-    screenprintf("draw from %.2f,%.2f t %.2f,%.2f\n", left.x, left.y, last_left.x, last_left.y);
-    glEnd();
+    strip->tail[0] = left;
+    strip->tail[1] = right;
+    strip->tail[2] = last_left;
+    strip->tail[3] = last_right;
+    for (int i = 0; i < 4; i++)
+    {
+        strip->tail_colors[i] = tail_color;
+    }
 
-    float2 dir = direction_2d(last_left, last_right);
-    M_SCALE2(dir, dir, half_width);
+    // Half of the path width past the right side
+    float2 dir;
+    M_SUB2(dir, last_right, last_left);
+    M_SCALE2(dir, dir, 0.5f);
     float2 middle;
     M_ADD2(middle, last_right, dir);
     return middle;
+}
 
+void GosperStrip_Draw(const struct GosperStrip* strip, const struct PointList* points)
+{
+    glEnableClientState(GL_VERTEX_ARRAY);
+    glEnableClientState(GL_COLOR_ARRAY);
+    if (strip->vertex_count >= 4)
+    {
+        glVertexPointer(2, GL_FLOAT, 0, points->points);
+        glColorPointer(4, GL_UNSIGNED_BYTE, 0, strip->colors);
+        glDrawArrays(GL_QUAD_STRIP, 0, strip->vertex_count);
+    }
+    // Quad from the last full segment to the partial end
+    glVertexPointer(2, GL_FLOAT, 0, strip->tail);
+    glColorPointer(4, GL_UNSIGNED_BYTE, 0, strip->tail_colors);
+    glDrawArrays(GL_QUAD_STRIP, 0, 4);
+    glDisableClientState(GL_COLOR_ARRAY);
+    glDisableClientState(GL_VERTEX_ARRAY);
+}
 
+float2 Gosper_Draw(struct PointList* list, struct Gradient* gradient, float amount, float gradient_offset, float gradient_step_prct)
+{
+    static struct GosperStrip strip = {0};
+    float2 middle = GosperStrip_Prepare(&strip, list, gradient, amount, gradient_offset, gradient_step_prct);
+    GosperStrip_Draw(&strip, list);
+    return middle;
 }
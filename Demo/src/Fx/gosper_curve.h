@@ -5,9 +5,106 @@
 #include "pointlist.h"
 #include "gradient.h"
 
+// Deepest recursion the walker has stack for
+#define GOSPER_MAX_RECURSION 7
+
+// Point split into the part that does not depend on width and the part that does
+struct GosperPoint
+{
+    float2 base;
+    float2 offset;
+};
+
+// Position inside the production of an A or B symbol
+struct GosperFrame
+{
+    char symbol;
+    short level;
+    short next;
+};
+
+/**
+ * @brief Each point of the curve is base + offset * half width.
+ * The base and offset only depend on the start, step and recursion level,
+ * so a new path width is a single pass over the points.
+ * The points are generated on demand, the walker continues where it stopped.
+ */
+struct GosperCurve
+{
+    float2* base;
+    float2* offset;
+    int point_count;
+    int allocated_size;
+    short recursion_level; // -1 when nothing is cached
+    float2 start;
+    float2 start_dir;
+    float step;
+
+    // Walker state between GosperCurve_Extend calls
+    struct GosperFrame stack[GOSPER_MAX_RECURSION + 1];
+    short stack_size;          // 0 when the whole curve is generated
+    struct GosperPoint latest; // Middle point of the path
+    struct GosperPoint left;   // Left side of path
+    struct GosperPoint right;  // Right side of path
+    float2 direction;
+    float2 to_right;           // Per unit of half width
+};
+
+struct GosperCurve GosperCurve_CreateEmpty(void);
+
+/**
+ * @brief Start a new curve, does nothing if these parameters are already cached.
+ * Only the start of the path is generated, see GosperCurve_Extend.
+ */
+void GosperCurve_Build(struct GosperCurve* curve, float2 start, float2 start_dir, float step_length, short recursion_level);
+
+/**
+ * @brief Generate at least the points Gosper_Draw needs for this many segments
+ * @return Point count of the curve
+ */
+int GosperCurve_Extend(struct GosperCurve* curve, float segments);
+
+/**
+ * @brief Write the left and right points of the path with the given width
+ * @param first Points before this already have this width
+ */
+void GosperCurve_ApplyWidth(const struct GosperCurve* curve, float path_width, struct PointList* points, int first);
+
+void GosperCurve_Free(struct GosperCurve* curve);
+
+/**
+ * @brief Build and apply the width in one go, for curves that are created only once
+ */
 void Gosper_Create(struct PointList* list, float2 start, float2 start_dir, float step_length, float path_width, short recursion_level);
 
 
+/**
+ * @brief Colors and the partial end of a curve, ready to be drawn with vertex arrays
+ * straight from the PointList. Can be drawn many times with different matrices.
+ */
+struct GosperStrip
+{
+    unsigned int* colors;   // RGBA8 of each vertex of the full segments
+    int color_capacity;
+    int vertex_count;       // Vertices of the full segments
+    float2 tail[4];         // Last full pair and the partial pair after it
+    unsigned int tail_colors[4];
+};
+
+struct GosperStrip GosperStrip_CreateEmpty(void);
+
+/**
+ * @brief Evaluate the gradient for every segment and set up the partial end
+ * @param amount How many segments to draw. 3.5 draws 3 full and a half segment
+ * @return The point that will be drawn last
+ */
+float2 GosperStrip_Prepare(struct GosperStrip* strip, struct PointList* points, struct Gradient* gradient, float amount, float gradient_offset, float gradient_step_prct);
+
+/**
+ * @brief Draw a prepared strip, points must be the same list it was prepared with
+ */
+void GosperStrip_Draw(const struct GosperStrip* strip, const struct PointList* points);
+
 /**
  * @brief Draws the curve.
  * @param points The points of curve
@@ -15,7 +112,4 @@ void Gosper_Create(struct PointList* list, float2 start, float2 start_dir, float
  * @return The point that was drawn last
  */
 float2 Gosper_Draw(struct PointList* points, struct Gradient* gradient, float amount, float gradient_offset, float gradient_step_prct);
-
-void Gosper_A(struct PointList* points, short recursion_level);
-void Gosper_B(struct PointList* points, short recursion_level);
 #endif
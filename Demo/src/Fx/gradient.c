@@ -3,6 +3,19 @@
 #include "../Ziz/screenprint.h"
 #include "color_manager.h"
 #include <opengl_include.h>
+#include <stdlib.h>
+
+#if defined(__SSE2__) || defined(_M_X64)
+#include <emmintrin.h>
+#define GRADIENT_USE_SSE
+#endif
+
+#ifndef GL_MIRRORED_REPEAT
+#define GL_MIRRORED_REPEAT 0x8370
+#endif
+
+// Rows of the gradient texture, a few so that GX gets whole 4x4 tiles
+#define GRADIENT_TEXTURE_ROWS 4
 
 struct Gradient Gradient_CreateEmpty(enum GradientShape shape, enum GradientLoopMode loop_mode)
 {
@@ -12,6 +25,8 @@ struct Gradient Gradient_CreateEmpty(enum GradientShape shape, enum GradientLoop
     g.loop_mode = loop_mode;
     g.alpha = 1.0f;
     g.repeats = 1.0f;
+    g.lut = NULL;
+    g.version = 0;
     return g;
 }
 
@@ -22,6 +37,7 @@ void Gradient_PushColor(struct Gradient* gradient, color3* color, float stop)
         gradient->colors[gradient->color_amount] = color;
         gradient->stops[gradient->color_amount] = stop;
         gradient->color_amount++;
+        gradient->version++;
     }
 }
 
@@ -32,6 +48,7 @@ void Gradient_PushName(struct Gradient* gradient, enum ColorName name, float sto
         gradient->colors[gradient->color_amount] = ColorManager_GetName(name);
         gradient->stops[gradient->color_amount] = stop;
         gradient->color_amount++;
+        gradient->version++;
     }
 }
 
@@ -46,6 +63,7 @@ void Gradient_PushColorArray(struct Gradient* gradient, enum ColorName* colors,
             gradient->stops[i] = step * i;
         }
         gradient->color_amount = amount;
+        gradient->version++;
     }
 }
 
@@ -65,11 +83,11 @@ void Gradient_glColorA(struct Gradient* gradient, float stop, float alpha)
     glColor4f(between.r, between.g, between.b, alpha);
 }
 
-color3 Gradient_GetColor(struct Gradient* gradient, float stop)
+/**
+ * @brief Apply repeats and looping, the result is between 0.0 and 1.0
+ */
+static float gradient_read_stop(const struct Gradient* gradient, float stop)
 {
-    // NOTE must have at least 2 colors for this to work
-    short before_index = 0;
-    short after_index = gradient->color_amount;
     float read_stop = 0.0f;
 
     // Repeat and negative
@@ -120,7 +138,17 @@ color3 Gradient_GetColor(struct Gradient* gradient, float stop)
     {
         read_stop = stop;
     }
-    //screenprintf("Stop: %.4f, Read: %.4f", stop, read_stop);
+    return read_stop;
+}
+
+/**
+ * @brief Color at a read stop, by searching the stops
+ */
+static color3 gradient_evaluate(const struct Gradient* gradient, float read_stop)
+{
+    // NOTE must have at least 2 colors for this to work
+    short before_index = 0;
+    short after_index = gradient->color_amount;
 
     for (short i = 0; i < gradient->color_amount-1; i++)
     {
@@ -147,3 +175,328 @@ color3 Gradient_GetColor(struct Gradient* gradient, float stop)
     between.b = color_lerp(before->b, after->b, t);
     return between;
 }
+
+color3 Gradient_GetColorExact(struct Gradient* gradient, float stop)
+{
+    return gradient_evaluate(gradient, gradient_read_stop(gradient, stop));
+}
+
+static int gradient_push_break(struct GradientBreak* breaks, int amount, int max_breaks, float stop, color3 color)
+{
+    if (amount < 0 || amount >= max_breaks)
+    {
+        return -1;
+    }
+    breaks[amount].stop = stop;
+    breaks[amount].color = color;
+    return amount + 1;
+}
+
+/**
+ * @brief Read stops just before and after the whole number of periods period
+ */
+static void gradient_period_edges(const struct Gradient* gradient, int period, float* left, float* right)
+{
+    const bool mirror = gradient->loop_mode == GradientLoopMirror;
+    const int whole = period > 0 ? period : -period;
+    // The absolute value is below whole on the side of 0
+    const float below = (mirror && (whole - 1) % 2 == 1) ? 0.0f : 1.0f;
+    const float above = (mirror && whole % 2 == 1) ? 1.0f : 0.0f;
+    if (period == 0)
+    {
+        *left = 0.0f;
+        *right = 0.0f;
+    }
+    else
+    {
+        *left = period > 0 ? below : above;
+        *right = period > 0 ? above : below;
+    }
+}
+
+int Gradient_GetBreaks(struct Gradient* gradient, float from, float to, struct GradientBreak* breaks, int max_breaks)
+{
+    if (gradient->color_amount < 2 || to < from)
+    {
+        return 0;
+    }
+    const float scale = gradient->repeats > 0.0f ? gradient->repeats : 1.0f;
+    const bool mirror = gradient->loop_mode == GradientLoopMirror;
+    const float read_from = from * scale;
+    const float read_to = to * scale;
+    const short last_kink = gradient->color_amount - 2;
+    int amount = 0;
+
+    // Ends on a whole period take the color of the inside
+    float left;
+    float right;
+    color3 first = Gradient_GetColorExact(gradient, from);
+    if (floorf(read_from) == read_from)
+    {
+        gradient_period_edges(gradient, (int)read_from, &left, &right);
+        first = gradient_evaluate(gradient, right);
+    }
+    color3 last = Gradient_GetColorExact(gradient, to);
+    if (floorf(read_to) == read_to)
+    {
+        gradient_period_edges(gradient, (int)read_to, &left, &right);
+        last = gradient_evaluate(gradient, left);
+    }
+
+    amount = gradient_push_break(breaks, amount, max_breaks, from, first);
+    for (int period = (int)floorf(read_from); period <= (int)floorf(read_to); period++)
+    {
+        // Start of the period: the absolute value turns at 0, repeat jumps at the others
+        if ((float)period > read_from && (float)period < read_to)
+        {
+            const float stop = (float)period / scale;
+            gradient_period_edges(gradient, period, &left, &right);
+            amount = gradient_push_break(breaks, amount, max_breaks, stop, gradient_evaluate(gradient, left));
+            if (right != left)
+            {
+                amount = gradient_push_break(breaks, amount, max_breaks, stop, gradient_evaluate(gradient, right));
+            }
+        }
+
+        // The stops where the color search moves to the next pair, backwards if this period is read reversed
+        const int whole = period >= 0 ? period : -period - 1;
+        const bool reversed = (period < 0) != (mirror && whole % 2 == 1);
+        for (short k = 1; k <= last_kink; k++)
+        {
+            const short i = reversed ? last_kink + 1 - k : k;
+            const float kink = gradient->stops[i];
+            if (kink <= 0.0f || kink >= 1.0f)
+            {
+                continue;
+            }
+            const float position = (float)period + (reversed ? 1.0f - kink : kink);
+            if (position > read_from && position < read_to)
+            {
+                amount = gradient_push_break(breaks, amount, max_breaks, position / scale, gradient_evaluate(gradient, kink));
+            }
+        }
+    }
+    amount = gradient_push_break(breaks, amount, max_breaks, to, last);
+    return amount > 0 ? amount : 0;
+}
+
+void Gradient_Invalidate(struct Gradient* gradient)
+{
+    gradient->version++;
+}
+
+struct GradientLut
+{
+    // The gradient and version the colors were baked for
+    const struct Gradient* owner;
+    unsigned int version;
+    color3 colors[GRADIENT_LUT_SIZE];
+
+    // The colors as a texture for the textured gradient shapes, 0 until created
+    unsigned int texture_name;
+    bool texture_valid;
+};
+
+/**
+ * @brief Bake the color table if needed
+ * @return False if the gradient has too few colors for a table
+ */
+static bool gradient_bake_lut(struct Gradient* gradient)
+{
+    struct GradientLut* lut = gradient->lut;
+    if (lut != NULL && lut->owner == gradient && lut->version == gradient->version)
+    {
+        return true;
+    }
+    if (gradient->color_amount < 2)
+    {
+        return false;
+    }
+    if (lut == NULL || lut->owner != gradient)
+    {
+        // Copies of the gradient keep pointing at the table of the original
+        lut = (struct GradientLut*)malloc(sizeof(struct GradientLut));
+        if (lut == NULL)
+        {
+            return false;
+        }
+        lut->owner = gradient;
+        lut->texture_name = 0;
+        gradient->lut = lut;
+    }
+    for (int i = 0; i < GRADIENT_LUT_SIZE; i++)
+    {
+        lut->colors[i] = gradient_evaluate(gradient, (float)i / (float)(GRADIENT_LUT_SIZE - 1));
+    }
+    lut->version = gradient->version;
+    lut->texture_valid = false;
+    return true;
+}
+
+void Gradient_Free(struct Gradient* gradient)
+{
+    struct GradientLut* lut = gradient->lut;
+    // A copy does not own the table it points to
+    if (lut != NULL && lut->owner == gradient)
+    {
+        if (lut->texture_name != 0)
+        {
+            GLuint name = lut->texture_name;
+            glDeleteTextures(1, &name);
+        }
+        free(lut);
+    }
+    gradient->lut = NULL;
+}
+
+static color3 gradient_lerp_lut(const struct Gradient* gradient, int index, float t)
+{
+    const color3* before = &gradient->lut->colors[index];
+    const color3* after = &gradient->lut->colors[index + 1];
+    color3 between;
+    between.r = color_lerp(before->r, after->r, t);
+    between.g = color_lerp(before->g, after->g, t);
+    between.b = color_lerp(before->b, after->b, t);
+    return between;
+}
+
+static color3 gradient_lookup(const struct Gradient* gradient, float read_stop)
+{
+    const float position = read_stop * (float)(GRADIENT_LUT_SIZE - 1);
+    int index = (int)position;
+    index = M_CLAMP(index, 0, GRADIENT_LUT_SIZE - 2);
+    return gradient_lerp_lut(gradient, index, position - (float)index);
+}
+
+color3 Gradient_GetColor(struct Gradient* gradient, float stop)
+{
+    if (!gradient_bake_lut(gradient))
+    {
+        return Gradient_GetColorExact(gradient, stop);
+    }
+    return gradient_lookup(gradient, gradient_read_stop(gradient, stop));
+}
+
+// Stops handled per pass of Gradient_GetColors
+#define GRADIENT_BATCH 64
+
+/**
+ * @brief Table index and lerp amount of count stops, the arithmetic of gradient_read_stop without branches
+ */
+static void gradient_batch_positions(const float* stops, int count, float scale, float mirror, int* indices, float* ts)
+{
+    int i = 0;
+#ifdef GRADIENT_USE_SSE
+    const __m128 sign = _mm_set1_ps(-0.0f);
+    const __m128 one = _mm_set1_ps(1.0f);
+    const __m128 two = _mm_set1_ps(2.0f);
+    const __m128 scale4 = _mm_set1_ps(scale);
+    const __m128 mirror4 = _mm_set1_ps(mirror);
+    const __m128 last = _mm_set1_ps((float)(GRADIENT_LUT_SIZE - 2));
+    const __m128 size = _mm_set1_ps((float)(GRADIENT_LUT_SIZE - 1));
+    const __m128i odd_bit = _mm_set1_epi32(1);
+    for (; i + 4 <= count; i += 4)
+    {
+        const __m128 stop = _mm_andnot_ps(sign, _mm_mul_ps(_mm_loadu_ps(&stops[i]), scale4));
+        // Stops are not negative, so truncating is floor
+        const __m128i whole_i = _mm_cvttps_epi32(stop);
+        const __m128 decimal_part = _mm_sub_ps(stop, _mm_cvtepi32_ps(whole_i));
+        const __m128 odd = _mm_mul_ps(_mm_cvtepi32_ps(_mm_and_si128(whole_i, odd_bit)), mirror4);
+        const __m128 looped = _mm_add_ps(decimal_part,
+                                         _mm_mul_ps(odd, _mm_sub_ps(one, _mm_mul_ps(two, decimal_part))));
+        const __m128 wraps = _mm_cmpgt_ps(stop, one);
+        const __m128 read_stop = _mm_or_ps(_mm_and_ps(wraps, looped), _mm_andnot_ps(wraps, stop));
+        const __m128 position = _mm_mul_ps(read_stop, size);
+        const __m128 index = _mm_min_ps(_mm_cvtepi32_ps(_mm_cvttps_epi32(position)), last);
+        _mm_storeu_si128((__m128i*)&indices[i], _mm_cvttps_epi32(index));
+        _mm_storeu_ps(&ts[i], _mm_sub_ps(position, index));
+    }
+#endif
+    for (; i < count; i++)
+    {
+        const float stop = fabsf(stops[i] * scale);
+        const float whole = floorf(stop);
+        const float decimal_part = stop - whole;
+        const float odd = (whole - 2.0f * floorf(whole * 0.5f)) * mirror;
+        const float looped = decimal_part + odd * (1.0f - 2.0f * decimal_part);
+        const float read_stop = stop > 1.0f ? looped : stop;
+        const float position = read_stop * (float)(GRADIENT_LUT_SIZE - 1);
+        const int index = M_MIN((int)position, GRADIENT_LUT_SIZE - 2);
+        indices[i] = index;
+        ts[i] = position - (float)index;
+    }
+}
+
+void Gradient_GetColors(struct Gradient* gradient, const float* stops, int n, color3* out)
+{
+    if (!gradient_bake_lut(gradient))
+    {
+        for (int i = 0; i < n; i++)
+        {
+            out[i] = Gradient_GetColorExact(gradient, stops[i]);
+        }
+        return;
+    }
+
+    const float scale = gradient->repeats > 0.0f ? gradient->repeats : 1.0f;
+    const float mirror = gradient->loop_mode == GradientLoopMirror ? 1.0f : 0.0f;
+    int indices[GRADIENT_BATCH];
+    float ts[GRADIENT_BATCH];
+    for (int first = 0; first < n; first += GRADIENT_BATCH)
+    {
+        const int count = M_MIN(GRADIENT_BATCH, n - first);
+        gradient_batch_positions(&stops[first], count, scale, mirror, indices, ts);
+        for (int i = 0; i < count; i++)
+        {
+            out[first + i] = gradient_lerp_lut(gradient, indices[i], ts[i]);
+        }
+    }
+}
+
+bool Gradient_BindTexture(struct Gradient* gradient)
+{
+    if (!gradient_bake_lut(gradient))
+    {
+        return false;
+    }
+    struct GradientLut* lut = gradient->lut;
+    if (lut->texture_name == 0)
+    {
+        GLuint name;
+        glGenTextures(1, &name);
+        lut->texture_name = name;
+    }
+    glBindTexture(GL_TEXTURE_2D, lut->texture_name);
+
+    if (!lut->texture_valid)
+    {
+        // Texel centers, so that linear filtering reads the same colors as the table
+        static unsigned char texels[GRADIENT_TEXTURE_ROWS][GRADIENT_LUT_SIZE][3];
+        for (int i = 0; i < GRADIENT_LUT_SIZE; i++)
+        {
+            color3 color = gradient_lookup(gradient, ((float)i + 0.5f) / (float)GRADIENT_LUT_SIZE);
+            texels[0][i][0] = (unsigned char)(M_CLAMP(color.r, 0.0f, 1.0f) * 255.0f);
+            texels[0][i][1] = (unsigned char)(M_CLAMP(color.g, 0.0f, 1.0f) * 255.0f);
+            texels[0][i][2] = (unsigned char)(M_CLAMP(color.b, 0.0f, 1.0f) * 255.0f);
+        }
+        for (int row = 1; row < GRADIENT_TEXTURE_ROWS; row++)
+        {
+            memcpy(texels[row], texels[0], sizeof(texels[0]));
+        }
+        glTexImage2D(GL_TEXTURE_2D, 0, GL_RGB8, GRADIENT_LUT_SIZE, GRADIENT_TEXTURE_ROWS,
+                     0, GL_RGB, GL_UNSIGNED_BYTE, texels);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP);
+        lut->texture_valid = true;
+    }
+    // Mirrored repeat matches the mirror loop and the absolute value of negative stops
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S,
+                    gradient->loop_mode == GradientLoopMirror ? GL_MIRRORED_REPEAT : GL_REPEAT);
+    return true;
+}
+
+float Gradient_TextureCoord(const struct Gradient* gradient, float stop)
+{
+    return gradient->repeats > 0.0f ? stop * gradient->repeats : stop;
+}
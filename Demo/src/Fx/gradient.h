@@ -1,6 +1,7 @@
 #ifndef GRADIENT_H
 #define GRADIENT_H
 // Refers to colors in color manager and has 2 or more stops
+#include <stdbool.h>
 #include "color_manager.h"
 
 enum GradientShape
@@ -17,6 +18,9 @@ enum GradientLoopMode
 };
 
 #define GRADIENT_SIZE 12
+// Entries of the baked color table, the halo gradients have stops 0.01 apart
+#define GRADIENT_LUT_SIZE 1024
+struct GradientLut;
 struct Gradient
 {
     color3* colors[GRADIENT_SIZE];
@@ -26,6 +30,22 @@ struct Gradient
     float repeats;
     enum GradientShape shape;
     enum GradientLoopMode loop_mode;
+
+    // Colors from 0.0 to 1.0 after repeats and looping have been applied,
+    // so the table does not depend on them, and its texture. Allocated on
+    // first use and owned by this gradient: a copy bakes its own table and
+    // texture, so copy gradients before using them. See Gradient_Free.
+    struct GradientLut* lut;
+
+    // Changes with the colors or stops, for caches of drawn gradients
+    unsigned int version;
+};
+
+// A stop where the color changes slope or jumps
+struct GradientBreak
+{
+    float stop;
+    color3 color;
 };
 
 struct Gradient Gradient_CreateEmpty(enum GradientShape shape, enum GradientLoopMode loop_mode);
@@ -39,4 +59,50 @@ void Gradient_glColorA(struct Gradient* gradient, float stop, float alpha);
 
 color3 Gradient_GetColor(struct Gradient* gradient, float stop);
 
+/**
+ * @brief Colors of many stops at once
+ * @param stops n stops, same as given to Gradient_GetColor
+ * @param out n colors
+ */
+void Gradient_GetColors(struct Gradient* gradient, const float* stops, int n, color3* out);
+
+/**
+ * @brief Gradient_GetColor without the color table, searches the stops every time
+ */
+color3 Gradient_GetColorExact(struct Gradient* gradient, float stop);
+
+/**
+ * @brief Stops from from to to where the gradient is not linear, with their exact colors.
+ * Between two consecutive breaks the color is linear in the stop, so slicing a shape there
+ * gives the exact gradient. Starts with from and ends with to. A jump, the end of a period
+ * in repeat mode, is given twice with the same stop: the color before and after it.
+ * @return Amount of breaks, 0 if they do not fit in max_breaks or the gradient has too few colors
+ */
+int Gradient_GetBreaks(struct Gradient* gradient, float from, float to, struct GradientBreak* breaks, int max_breaks);
+
+/**
+ * @brief Bind the gradient as a GL_TEXTURE_2D, baking it first if needed.
+ * The texture is one color row: s is the stop times repeats, the wrap mode follows the loop mode.
+ * @return False if the gradient has too few colors
+ */
+bool Gradient_BindTexture(struct Gradient* gradient);
+
+/**
+ * @brief Texture coordinate s of a stop, see Gradient_BindTexture.
+ * With GradientLoopRepeat negative stops read the gradient mirrored,
+ * so primitives must not cross s = 0 and use the absolute value.
+ */
+float Gradient_TextureCoord(const struct Gradient* gradient, float stop);
+
+/**
+ * @brief Release the color table and texture of the gradient, it can be used again after this
+ */
+void Gradient_Free(struct Gradient* gradient);
+
+/**
+ * @brief Rebake the color table and redraw cached backgrounds on next use. Call after changing colors or stops directly,
+ * the push functions do it already.
+ */
+void Gradient_Invalidate(struct Gradient* gradient);
+
 #endif
@@ -3,10 +3,230 @@
 #include <m_float2_math.h>
 #include <texture.h>
 
-void GradientTexture_DrawVerticalGradient(struct Gradient* gradient, float2 texture_size, bool uvs, float gradient_offset)
+// Shapes are drawn with the gradient texture when possible,
+// the tessellated versions give per vertex colors instead
+static bool gradient_textures = true;
+
+void GradientTexture_UseGradientTextures(bool enabled)
+{
+    gradient_textures = enabled;
+}
+
+// Segments of the round shapes
+#define GRADIENT_SEGMENTS 32
+// Wedges of the radial gradient, the last one covers the first again
+#define GRADIENT_WEDGES (GRADIENT_SEGMENTS + 1)
+// Rings of the tessellated circle
+#define GRADIENT_MAX_RINGS 64
+
+// Unit size geometry of the round shapes, built once and scaled when drawn
+struct GradientShapeCache
+{
+    float2 circle[GRADIENT_SEGMENTS + 2];
+    float2 radial_positions[GRADIENT_WEDGES * 3];
+    float2 radial_uvs[GRADIENT_WEDGES * 3];
+    float2 circle_positions[GRADIENT_SEGMENTS * 3];
+    unsigned short ring_indices[(GRADIENT_MAX_RINGS - 1) * GRADIENT_SEGMENTS * 4];
+    bool ready;
+};
+static struct GradientShapeCache shape_cache;
+
+// Refilled when the offset moves
+static float2 shape_texcoords[GRADIENT_WEDGES * 3];
+static unsigned int shape_colors[GRADIENT_WEDGES * 3];
+static float2 ring_positions[GRADIENT_MAX_RINGS * (GRADIENT_SEGMENTS + 1)];
+static unsigned int ring_colors[GRADIENT_MAX_RINGS * (GRADIENT_SEGMENTS + 1)];
+
+static const struct GradientShapeCache* GradientShapes(void)
+{
+    struct GradientShapeCache* cache = &shape_cache;
+    if (cache->ready)
+    {
+        return cache;
+    }
+    const float2 center = {0.0f, 0.0f};
+    const float2 right = {1.0f, 0.0f};
+    for (short i = 0; i < GRADIENT_SEGMENTS + 2; i++)
+    {
+        cache->circle[i] = M_ROTATE2(right, M_TAU * (float)i / (float)GRADIENT_SEGMENTS);
+    }
+    for (short i = 0; i < GRADIENT_WEDGES; i++)
+    {
+        float2* wedge = &cache->radial_positions[i * 3];
+        wedge[0] = center;
+        wedge[1] = cache->circle[i];
+        wedge[2] = cache->circle[i + 1];
+        for (short v = 0; v < 3; v++)
+        {
+            cache->radial_uvs[i * 3 + v].x = 0.5f + wedge[v].x / 2.0f;
+            cache->radial_uvs[i * 3 + v].y = 0.5f + wedge[v].y / 2.0f;
+        }
+    }
+    for (short i = 0; i < GRADIENT_SEGMENTS; i++)
+    {
+        cache->circle_positions[i * 3] = center;
+        cache->circle_positions[i * 3 + 1] = cache->circle[i];
+        cache->circle_positions[i * 3 + 2] = cache->circle[i + 1];
+    }
+    // Quads between ring k and k + 1, drawing fewer rings uses the start
+    unsigned short* index = cache->ring_indices;
+    const unsigned short ring_size = GRADIENT_SEGMENTS + 1;
+    for (short ring = 0; ring + 1 < GRADIENT_MAX_RINGS; ring++)
+    {
+        for (short i = 0; i < GRADIENT_SEGMENTS; i++)
+        {
+            const unsigned short inner = ring * ring_size + i;
+            const unsigned short outer = inner + ring_size;
+            *index++ = inner + 1;
+            *index++ = inner;
+            *index++ = outer;
+            *index++ = outer + 1;
+        }
+    }
+    cache->ready = true;
+    return cache;
+}
+
+// Textured triangles built for this draw, when the cached shapes can not be used
+#define GRADIENT_BATCH_VERTICES (GRADIENT_WEDGES * 9)
+static float2 batch_positions[GRADIENT_BATCH_VERTICES];
+static float2 batch_texcoords[GRADIENT_BATCH_VERTICES];
+static int batch_count;
+
+static void DrawTexturedArrays(const float2* positions, const float2* texcoords, int count)
 {
-    float smoothness = 10.0f; // Pixels per quad
-  //screenprintf("Gradient repeat %.2f", gradient_repeat);
+    glEnableClientState(GL_VERTEX_ARRAY);
+    glEnableClientState(GL_TEXTURE_COORD_ARRAY);
+    glVertexPointer(2, GL_FLOAT, 0, positions);
+    glTexCoordPointer(2, GL_FLOAT, 0, texcoords);
+    glDrawArrays(GL_TRIANGLES, 0, count);
+    glDisableClientState(GL_TEXTURE_COORD_ARRAY);
+    glDisableClientState(GL_VERTEX_ARRAY);
+}
+
+static bool BeginTexturedGradient(struct Gradient* gradient, float alpha)
+{
+    if (!gradient_textures || !Gradient_BindTexture(gradient))
+    {
+        return false;
+    }
+    glEnable(GL_TEXTURE_2D);
+    glColor4f(1.0f, 1.0f, 1.0f, alpha);
+    batch_count = 0;
+    return true;
+}
+
+static void EndTexturedGradient(void)
+{
+    if (batch_count > 0)
+    {
+        DrawTexturedArrays(batch_positions, batch_texcoords, batch_count);
+    }
+    glDisable(GL_TEXTURE_2D);
+}
+
+static void GradientVertex(float2 point, float s)
+{
+    if (batch_count < GRADIENT_BATCH_VERTICES)
+    {
+        batch_positions[batch_count] = point;
+        batch_texcoords[batch_count].x = s;
+        batch_texcoords[batch_count].y = 0.5f;
+        batch_count++;
+    }
+}
+
+/**
+ * @brief True if s goes through 0 between first and last and the texture can not be read
+ * across it, see GradientTriangle
+ */
+static bool GradientCrossesZero(const struct Gradient* gradient, float first, float last)
+{
+    return gradient->loop_mode == GradientLoopRepeat
+        && ((first < 0.0f && last > 0.0f) || (first > 0.0f && last < 0.0f));
+}
+
+static void FillTexcoord(float2* texcoord, float s)
+{
+    texcoord->x = fabsf(s);
+    texcoord->y = 0.5f;
+}
+
+static float2 LerpPoint(float2 a, float2 b, float t)
+{
+    float2 point = {a.x + (b.x - a.x) * t, a.y + (b.y - a.y) * t};
+    return point;
+}
+
+/**
+ * @brief Triangle with gradient texture coordinates.
+ * In repeat mode negative stops use the absolute value, so the triangle is cut where s crosses 0.
+ */
+static void GradientTriangle(const struct Gradient* gradient, float2 a, float2 b, float2 c, float sa, float sb, float sc)
+{
+    const bool all_positive = sa >= 0.0f && sb >= 0.0f && sc >= 0.0f;
+    const bool all_negative = sa <= 0.0f && sb <= 0.0f && sc <= 0.0f;
+    if (gradient->loop_mode == GradientLoopMirror || all_positive || all_negative)
+    {
+        GradientVertex(a, fabsf(sa));
+        GradientVertex(b, fabsf(sb));
+        GradientVertex(c, fabsf(sc));
+        return;
+    }
+
+    // Rotate the corners so that a is alone on its side of 0
+    if ((sa < 0.0f) == (sc < 0.0f))
+    {
+        float2 p = a; a = b; b = c; c = p;
+        float s = sa; sa = sb; sb = sc; sc = s;
+    }
+    else if ((sa < 0.0f) == (sb < 0.0f))
+    {
+        float2 p = a; a = c; c = b; b = p;
+        float s = sa; sa = sc; sc = sb; sb = s;
+    }
+    float2 ab = LerpPoint(a, b, sa / (sa - sb));
+    float2 ac = LerpPoint(a, c, sa / (sa - sc));
+    GradientVertex(a, fabsf(sa));
+    GradientVertex(ab, 0.0f);
+    GradientVertex(ac, 0.0f);
+
+    GradientVertex(ab, 0.0f);
+    GradientVertex(b, fabsf(sb));
+    GradientVertex(c, fabsf(sc));
+
+    GradientVertex(ab, 0.0f);
+    GradientVertex(c, fabsf(sc));
+    GradientVertex(ac, 0.0f);
+}
+
+// Most breaks a tessellated shape takes, past this it is sliced evenly
+#define GRADIENT_MAX_BREAKS 256
+
+/**
+ * @brief Slices of a tessellated shape from stop from to stop to: at the gradient breaks,
+ * or evenly into at most uniform_slices if there are more than max_breaks of them
+ * @return Amount of breaks written
+ */
+static int GradientSlices(struct Gradient* gradient, float from, float to, int uniform_slices, struct GradientBreak* breaks, int max_breaks)
+{
+    int amount = Gradient_GetBreaks(gradient, from, to, breaks, max_breaks);
+    if (amount > 0)
+    {
+        return amount;
+    }
+    uniform_slices = M_CLAMP(uniform_slices, 1, max_breaks - 1);
+    for (int i = 0; i <= uniform_slices; i++)
+    {
+        breaks[i].stop = from + (to - from) * (float)i / (float)uniform_slices;
+        breaks[i].color = Gradient_GetColor(gradient, breaks[i].stop);
+    }
+    return uniform_slices + 1;
+}
+
+static void DrawVerticalGradientTessellated(struct Gradient* gradient, float2 texture_size, bool uvs, float gradient_offset)
+{
+    float smoothness = 10.0f; // Pixels per quad when the gradient has too many breaks
   // When drawn in the background, fill whole screen
     static const float screenWidth = 640.0f;
     static const float screenHeight = 480.0f;
@@ -23,198 +243,229 @@ void GradientTexture_DrawVerticalGradient(struct Gradient* gradient, float2 text
     }
 
     float du = 0.0f;
-    float dv = 1.0f;
-
     float ga = gradient->alpha;
 
-    glBegin(GL_QUAD_STRIP);
-    //glBegin(GL_LINE_LOOP);
-
-    float gradient_p = gradient_offset;
-    // First 2 : left | right
-    //screenprintf("Gradient point %d: %.2f", 0, gradient_p);
-    Gradient_glColorA(gradient, gradient_p, ga);
-    if (uvs) {glTexCoord2f(du, dv);}
-    glVertex2f(dx, dy);
+    static struct GradientBreak breaks[GRADIENT_MAX_BREAKS];
+    int amount = GradientSlices(gradient, gradient_offset, gradient_offset + 1.0f, size_y / smoothness, breaks, GRADIENT_MAX_BREAKS);
 
-    if (uvs) {glTexCoord2f(du+1.0f, dv);}
-    glVertex2f(dx + size_x, dy);
-
-    int slices =  size_y / smoothness;
-    //screenprintf("Slices %d", slices);
-
-    float gradient_step = 1.0f / (float)slices;
-    float y_step = size_y / (float)slices;
-    float v_step = 1.0f / (float)slices;
-    for (int i = 1; i < slices; i++)
+    // A row per break, a jump gives a row of no height
+    glBegin(GL_QUAD_STRIP);
+    for (int i = 0; i < amount; i++)
     {
-        Gradient_glColorA(gradient, gradient_p + gradient_step, ga);
-        if (uvs)glTexCoord2f(du, dv - v_step);
-        glVertex2f(dx, dy + y_step);
-
-        if (uvs)glTexCoord2f(du + 1.0f, dv - v_step);
-        glVertex2f(dx + size_x, dy + y_step);
-
-        dy += y_step;
-        dv -= v_step;
-        gradient_p += gradient_step;
-     //   screenprintf("Gradient point %d: %.2f", i, gradient_p);
+        float t = breaks[i].stop - gradient_offset;
+        float y = dy + size_y * t;
+        float dv = 1.0f - t;
+        glColor4f(breaks[i].color.r, breaks[i].color.g, breaks[i].color.b, ga);
+        if (uvs) {glTexCoord2f(du, dv);}
+        glVertex2f(dx, y);
+
+        if (uvs) {glTexCoord2f(du + 1.0f, dv);}
+        glVertex2f(dx + size_x, y);
     }
+    glEnd();
+}
 
-    dy += y_step;
-    dv -= v_step;
-    gradient_p += gradient_step;
-
-    // Last 2 : if only 2 colors in gradient, loop is skipped
-    //screenprintf("Gradient point %d: %.2f", slices, gradient_p);
-    Gradient_glColorA(gradient, gradient_p, ga);
-    if(uvs)glTexCoord2f(du, dv);
-    glVertex2f(dx, dy);
-
-    if(uvs)glTexCoord2f(du + 1.0f, dv);
-    glVertex2f(dx + size_x, dy);
+// One quad for the whole screen
+static bool DrawVerticalGradientTextured(struct Gradient* gradient, float gradient_offset)
+{
+    if (!BeginTexturedGradient(gradient, gradient->alpha))
+    {
+        return false;
+    }
+    static const float screenWidth = 640.0f;
+    static const float screenHeight = 480.0f;
+    float2 bottom_left = {-screenWidth/2, -screenHeight/2};
+    float2 bottom_right = {screenWidth/2, -screenHeight/2};
+    float2 top_left = {-screenWidth/2, screenHeight/2};
+    float2 top_right = {screenWidth/2, screenHeight/2};
+    float bottom = Gradient_TextureCoord(gradient, gradient_offset);
+    float top = Gradient_TextureCoord(gradient, gradient_offset + 1.0f);
+    GradientTriangle(gradient, bottom_left, bottom_right, top_right, bottom, bottom, top);
+    GradientTriangle(gradient, bottom_left, top_right, top_left, bottom, top, top);
+    EndTexturedGradient();
+    return true;
+}
 
-    glEnd();
+void GradientTexture_DrawVerticalGradient(struct Gradient* gradient, float2 texture_size, bool uvs, float gradient_offset)
+{
+    // With uvs the caller has its own texture bound
+    if (uvs || !DrawVerticalGradientTextured(gradient, gradient_offset))
+    {
+        DrawVerticalGradientTessellated(gradient, texture_size, uvs, gradient_offset);
+    }
 }
 
-static void DrawRadialGradient(struct Gradient* gradient, float texture_size, float gradient_size, bool uvs, float gradient_offset)
+static void DrawRadialGradientTessellated(struct Gradient* gradient, float texture_size, float gradient_size, bool uvs, float gradient_offset)
 {
-  float2 point = {gradient_size, 0.0f};
-  float2 uvpoint = {1.0f, 0.0f};
-  float2 rotated;
-  float uv_inset;
-  if (uvs)
+  const struct GradientShapeCache* cache = GradientShapes();
+  float radius = uvs ? texture_size : gradient_size;
+
+  // Color of each wedge edge, the wedge goes from one to the next
+  float stops[GRADIENT_WEDGES + 1];
+  color3 colors[GRADIENT_WEDGES + 1];
+  float gradient_angle = gradient_offset * M_TAU;
+  for (short i = 0; i <= GRADIENT_WEDGES; i++)
   {
-    point.x = texture_size;
+    stops[i] = gradient_angle + (float)i / (float)GRADIENT_SEGMENTS;
+  }
+  Gradient_GetColors(gradient, stops, GRADIENT_WEDGES + 1, colors);
+  for (short i = 0; i < GRADIENT_WEDGES; i++)
+  {
+    unsigned int left = ColorManager_ToRGBA8(colors[i]);
+    shape_colors[i * 3] = left;
+    shape_colors[i * 3 + 1] = left;
+    shape_colors[i * 3 + 2] = ColorManager_ToRGBA8(colors[i + 1]);
   }
-  short colors = gradient->color_amount;
-  short corners = 32.0f;
-  float gradient_angle = gradient_offset * M_TAU;
-  float gradient_angle_step = 1.0f / (float)corners;
-  float rotation_step = M_TAU / (float)corners;
-  float rotation_rad = 0.0f;
-  glBegin(GL_QUADS);
 
-  for (short i = 0; i <= corners; i++)
+  glPushMatrix();
+  glScalef(radius, radius, 1.0f);
+  glEnableClientState(GL_VERTEX_ARRAY);
+  glEnableClientState(GL_COLOR_ARRAY);
+  glVertexPointer(2, GL_FLOAT, 0, cache->radial_positions);
+  glColorPointer(4, GL_UNSIGNED_BYTE, 0, shape_colors);
+  if (uvs)
+  {
+    glEnableClientState(GL_TEXTURE_COORD_ARRAY);
+    glTexCoordPointer(2, GL_FLOAT, 0, cache->radial_uvs);
+  }
+  glDrawArrays(GL_TRIANGLES, 0, GRADIENT_WEDGES * 3);
+  if (uvs)
   {
-    // loop around for last segment
+    glDisableClientState(GL_TEXTURE_COORD_ARRAY);
+  }
+  glDisableClientState(GL_COLOR_ARRAY);
+  glDisableClientState(GL_VERTEX_ARRAY);
+  glPopMatrix();
+}
 
-    // Center
-    Gradient_glColor(gradient, gradient_angle);
-    if (uvs) glTexCoord2f(0.5f, 0.5f);
-    glVertex2f(0.0f, 0.0f);
+static void DrawCircleGradientTessellated(struct Gradient* gradient, float gradient_size, float gradient_offset)
+{
+  float smoothness = 10.0f;
+  const struct GradientShapeCache* cache = GradientShapes();
+  const short ring_size = GRADIENT_SEGMENTS + 1;
 
-    // Left
-    // color stays
-    if (uvs)
+  // A ring at each break, the same for every segment
+  static struct GradientBreak breaks[GRADIENT_MAX_RINGS];
+  int amount = GradientSlices(gradient, gradient_offset, gradient_offset + 1.0f, gradient_size / smoothness, breaks, GRADIENT_MAX_RINGS);
+  for (int ring = 0; ring < amount; ring++)
+  {
+    float radius = (breaks[ring].stop - gradient_offset) * gradient_size;
+    unsigned int color = ColorManager_ToRGBA8(breaks[ring].color);
+    float2* position = &ring_positions[ring * ring_size];
+    unsigned int* ring_color = &ring_colors[ring * ring_size];
+    for (short i = 0; i < ring_size; i++)
     {
-      rotated = M_ROTATE2(uvpoint, rotation_rad);
-      glTexCoord2f(0.5f + rotated.x/2.0f, 0.5f + rotated.y/2.0f);
+      position[i].x = cache->circle[i].x * radius;
+      position[i].y = cache->circle[i].y * radius;
+      ring_color[i] = color;
     }
+  }
 
-    rotated = M_ROTATE2(point, rotation_rad);
-    glVertex2f(rotated.x, rotated.y);
+  glEnableClientState(GL_VERTEX_ARRAY);
+  glEnableClientState(GL_COLOR_ARRAY);
+  glVertexPointer(2, GL_FLOAT, 0, ring_positions);
+  glColorPointer(4, GL_UNSIGNED_BYTE, 0, ring_colors);
+  glDrawElements(GL_QUADS, (amount - 1) * GRADIENT_SEGMENTS * 4, GL_UNSIGNED_SHORT, cache->ring_indices);
+  glDisableClientState(GL_COLOR_ARRAY);
+  glDisableClientState(GL_VERTEX_ARRAY);
+}
 
-    // right
-    float next_gradient = gradient_angle + gradient_angle_step;
-    if (next_gradient > 1.0f)
+// A triangle per wedge, the stop goes around the center
+static bool DrawRadialGradientTextured(struct Gradient* gradient, float gradient_size, float gradient_offset)
+{
+    if (!BeginTexturedGradient(gradient, 1.0f))
     {
-      next_gradient -= 1.0f;
+        return false;
+    }
+    const struct GradientShapeCache* cache = GradientShapes();
+    const float gradient_start = gradient_offset * M_TAU;
+    float stops[GRADIENT_WEDGES + 1];
+    for (short i = 0; i <= GRADIENT_WEDGES; i++)
+    {
+        stops[i] = Gradient_TextureCoord(gradient, gradient_start + (float)i / (float)GRADIENT_SEGMENTS);
     }
-    Gradient_glColor(gradient, next_gradient);
 
-    float next_rad = rotation_rad + rotation_step;
-    if (next_rad > M_TAU)
+    glPushMatrix();
+    glScalef(gradient_size, gradient_size, 1.0f);
+    if (!GradientCrossesZero(gradient, stops[0], stops[GRADIENT_WEDGES]))
     {
-      next_rad -= M_TAU;
+        for (short i = 0; i < GRADIENT_WEDGES; i++)
+        {
+            FillTexcoord(&shape_texcoords[i * 3], stops[i]);
+            FillTexcoord(&shape_texcoords[i * 3 + 1], stops[i]);
+            FillTexcoord(&shape_texcoords[i * 3 + 2], stops[i + 1]);
+        }
+        DrawTexturedArrays(cache->radial_positions, shape_texcoords, GRADIENT_WEDGES * 3);
     }
-    if (uvs)
+    else
     {
-      rotated = M_ROTATE2(uvpoint, next_rad);
-      glTexCoord2f(0.5f + rotated.x/2.0f, 0.5f + rotated.y/2.0f);
+        const float2* wedge = cache->radial_positions;
+        for (short i = 0; i < GRADIENT_WEDGES; i++, wedge += 3)
+        {
+            GradientTriangle(gradient, wedge[0], wedge[1], wedge[2], stops[i], stops[i], stops[i + 1]);
+        }
     }
+    EndTexturedGradient();
+    glPopMatrix();
+    return true;
+}
 
+// A triangle per segment, the stop goes from the center to the edge
+static bool DrawCircleGradientTextured(struct Gradient* gradient, float gradient_size, float gradient_offset)
+{
+    if (!BeginTexturedGradient(gradient, 1.0f))
+    {
+        return false;
+    }
+    const struct GradientShapeCache* cache = GradientShapes();
+    const float center_stop = Gradient_TextureCoord(gradient, gradient_offset);
+    const float edge_stop = Gradient_TextureCoord(gradient, gradient_offset + 1.0f);
 
-    rotated = M_ROTATE2(point, next_rad);
-    glVertex2f(rotated.x, rotated.y);
-
-    // Center again
-    // Color stays
-    if (uvs) glTexCoord2f(0.5f, 0.5f);
-    glVertex2f(0.0f, 0.0f);
-
-
-    // Next triangle
-    rotation_rad += rotation_step;
-    gradient_angle += gradient_angle_step;
-
-  }
-  glEnd();
+    glPushMatrix();
+    glScalef(gradient_size, gradient_size, 1.0f);
+    if (!GradientCrossesZero(gradient, center_stop, edge_stop))
+    {
+        for (short i = 0; i < GRADIENT_SEGMENTS; i++)
+        {
+            FillTexcoord(&shape_texcoords[i * 3], center_stop);
+            FillTexcoord(&shape_texcoords[i * 3 + 1], edge_stop);
+            FillTexcoord(&shape_texcoords[i * 3 + 2], edge_stop);
+        }
+        DrawTexturedArrays(cache->circle_positions, shape_texcoords, GRADIENT_SEGMENTS * 3);
+    }
+    else
+    {
+        const float2* segment = cache->circle_positions;
+        for (short i = 0; i < GRADIENT_SEGMENTS; i++, segment += 3)
+        {
+            GradientTriangle(gradient, segment[0], segment[1], segment[2], center_stop, edge_stop, edge_stop);
+        }
+    }
+    EndTexturedGradient();
+    glPopMatrix();
+    return true;
+}
 
+static void DrawRadialGradient(struct Gradient* gradient, float texture_size, float gradient_size, bool uvs, float gradient_offset)
+{
+    if (uvs || !DrawRadialGradientTextured(gradient, gradient_size, gradient_offset))
+    {
+        DrawRadialGradientTessellated(gradient, texture_size, gradient_size, uvs, gradient_offset);
+    }
 }
 
 static void DrawCircleGradient(struct Gradient* gradient, float gradient_size, float gradient_offset)
 {
-  screenprint("Draw Circle gradient");
-  float smoothness = 10.0f;
-  float points = 32.0f;
-  float2 direction = {1.0f, 0.0f};
-  float2 rotated_dir_left;
-  float2 rotated_dir_right;
-  float gradient_point = gradient_offset;
-  float rotation_step = M_TAU / points;
-  float rotation_rad = 0.0f;
-  short rings = gradient_size / smoothness;
-  float gradient_step = 1.0f / rings;
-  float ring_radius = gradient_size / rings;
-  glBegin(GL_QUADS);
-
-  for (short i = 0; i < points; i++)
-  {
-    // loop around for last segment
-    float ring_left_x = 0.0f;
-    float ring_left_y = 0.0f;
-    float ring_right_x = 0.0f;
-    float ring_right_y = 0.0f;
-    rotated_dir_left = M_ROTATE2(direction, rotation_rad);
-    float next_rad = rotation_rad + rotation_step;
-    if (next_rad > M_TAU)
-    {
-      next_rad -= M_TAU;
-    }
-    rotated_dir_right = M_ROTATE2(direction, next_rad);
-
-    gradient_point = gradient_offset;
-    for (short ring = 0; ring < rings; ring++)
-    {
-      // inner right
-      Gradient_glColor(gradient, gradient_point);
-      glVertex2f(ring_right_x, ring_right_y);
-      // inner Left
-      glVertex2f(ring_left_x, ring_left_y);
-
-      // Outer left
-      float next_gradient = gradient_point + gradient_step;
-      if (next_gradient > 1.0f)
-      {
-        next_gradient -= 1.0f;
-      }
-      Gradient_glColor(gradient, next_gradient);
-
-      short next_ring = ring + 1;
-      ring_left_x = rotated_dir_left.x * ring_radius * next_ring;
-      ring_left_y = rotated_dir_left.y * ring_radius * next_ring;
-      glVertex2f(ring_left_x, ring_left_y);
-
-      ring_right_x = rotated_dir_right.x * ring_radius * next_ring;
-      ring_right_y = rotated_dir_right.y * ring_radius * next_ring;
-      glVertex2f(ring_right_x, ring_right_y);
-
-      gradient_point = next_gradient;
+    screenprint("Draw Circle gradient");
+    // Below one ring the tessellated version draws nothing
+    if (gradient_size < 10.0f)
+    {
+        return;
+    }
+    if (!DrawCircleGradientTextured(gradient, gradient_size, gradient_offset))
+    {
+        DrawCircleGradientTessellated(gradient, gradient_size, gradient_offset);
     }
-    rotation_rad = next_rad;
-  }
-  glEnd();
 }
 
 struct GradientTexture GradientTexture_Create(GLuint gl_texture_name, int ziz_texture_id, enum GradientAlphaMode alphamode )
@@ -346,7 +597,6 @@ void GradientTexture_Draw(struct GradientTexture* texture, struct Gradient* grad
     */
 
     float2 texture_size2 = {texture_size, texture_size};
-    float2 grad_size2 = {gradient_size, gradient_size};
     switch (texture->alphamode)
     {
       case GradientMultiply:
@@ -393,6 +643,150 @@ void GradientTexture_DrawGradient(struct Gradient* gradient, enum GradientAlphaM
       }
 }
 
+// Largest background that fits in a GX texture
+#define GRADIENT_BACKGROUND_MAX_SIZE 1024
+
+struct GradientBackground GradientBackground_CreateEmpty(void)
+{
+    struct GradientBackground background;
+    memset(&background, 0, sizeof(background));
+    background.valid = false;
+    return background;
+}
+
+void GradientBackground_Invalidate(struct GradientBackground* background)
+{
+    background->valid = false;
+}
+
+static void GradientBackground_MakeKey(struct GradientBackgroundKey* key, const struct Gradient* gradient, float size, float offset,
+                                      color3 clear_color)
+{
+    // Cleared so that keys compare as memory
+    memset(key, 0, sizeof(*key));
+    key->gradient = gradient;
+    key->gradient_version = gradient->version;
+    key->shape = gradient->shape;
+    key->loop_mode = gradient->loop_mode;
+    key->repeats = gradient->repeats;
+    key->alpha = gradient->alpha;
+    key->size = size;
+    key->offset = offset;
+    glGetFloatv(GL_MODELVIEW_MATRIX, key->modelview);
+    glGetFloatv(GL_PROJECTION_MATRIX, key->projection);
+    key->clear_color = clear_color;
+    key->width = ctoy_frame_buffer_width();
+    key->height = ctoy_frame_buffer_height();
+}
+
+static int GradientBackground_TextureSize(int size)
+{
+    int texture_size = 8;
+    while (texture_size < size)
+    {
+        texture_size *= 2;
+    }
+    return texture_size;
+}
+
+/**
+ * @brief Copy the screen into the background texture
+ * @return False if the screen is too big for a texture
+ */
+static bool GradientBackground_Copy(struct GradientBackground* background)
+{
+    const int width = background->key.width;
+    const int height = background->key.height;
+    if (width > GRADIENT_BACKGROUND_MAX_SIZE || height > GRADIENT_BACKGROUND_MAX_SIZE)
+    {
+        return false;
+    }
+    if (background->texture_name == 0)
+    {
+        glGenTextures(1, &background->texture_name);
+    }
+    glBindTexture(GL_TEXTURE_2D, background->texture_name);
+    if (background->texture_width < width || background->texture_height < height)
+    {
+        background->texture_width = GradientBackground_TextureSize(width);
+        background->texture_height = GradientBackground_TextureSize(height);
+        glTexImage2D(GL_TEXTURE_2D, 0, GL_RGB8, background->texture_width, background->texture_height,
+                     0, GL_RGB, GL_UNSIGNED_BYTE, NULL);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP);
+    }
+    glCopyTexSubImage2D(GL_TEXTURE_2D, 0, 0, 0, 0, 0, width, height);
+    glBindTexture(GL_TEXTURE_2D, 0);
+    return true;
+}
+
+// The texture on the whole screen, pixel for pixel
+static void GradientBackground_DrawTexture(const struct GradientBackground* background)
+{
+    const float width = (float)background->key.width;
+    const float height = (float)background->key.height;
+    const float s = width / (float)background->texture_width;
+    const float t = height / (float)background->texture_height;
+    const GLboolean depth_test = glIsEnabled(GL_DEPTH_TEST);
+
+    glMatrixMode(GL_PROJECTION);
+    glPushMatrix();
+    glLoadIdentity();
+    glOrtho(0.0, width, 0.0, height, -1.0, 1.0);
+    glMatrixMode(GL_MODELVIEW);
+    glPushMatrix();
+    glLoadIdentity();
+
+    // Behind everything like the gradient was, so the depth buffer is left cleared
+    glDisable(GL_DEPTH_TEST);
+    glEnable(GL_TEXTURE_2D);
+    glBindTexture(GL_TEXTURE_2D, background->texture_name);
+    glColor3f(1.0f, 1.0f, 1.0f);
+    glBegin(GL_QUADS);
+        glTexCoord2f(0.0f, 0.0f);
+        glVertex2f(0.0f, 0.0f);
+        glTexCoord2f(s, 0.0f);
+        glVertex2f(width, 0.0f);
+        glTexCoord2f(s, t);
+        glVertex2f(width, height);
+        glTexCoord2f(0.0f, t);
+        glVertex2f(0.0f, height);
+    glEnd();
+    glBindTexture(GL_TEXTURE_2D, 0);
+    glDisable(GL_TEXTURE_2D);
+    if (depth_test)
+    {
+        glEnable(GL_DEPTH_TEST);
+    }
+
+    glMatrixMode(GL_PROJECTION);
+    glPopMatrix();
+    glMatrixMode(GL_MODELVIEW);
+    glPopMatrix();
+}
+
+bool GradientTexture_DrawBackground(struct GradientBackground* background, struct Gradient* gradient,
+                                    enum GradientAlphaMode alphamode, float size, float offset,
+                                    color3 clear_color)
+{
+    struct GradientBackgroundKey key;
+    GradientBackground_MakeKey(&key, gradient, size, offset, clear_color);
+    if (background->valid && memcmp(&key, &background->key, sizeof(key)) == 0)
+    {
+        GradientBackground_DrawTexture(background);
+        background->reuses++;
+        return false;
+    }
+
+    GradientTexture_DrawGradient(gradient, alphamode, size, offset);
+    background->key = key;
+    background->valid = GradientBackground_Copy(background);
+    background->redraws++;
+    return true;
+}
+
 void GradientTexture_SetFiltering(struct GradientTexture* texture, GLenum mode)
 {
     glEnable(GL_TEXTURE_2D);
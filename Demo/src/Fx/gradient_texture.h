@@ -50,6 +50,65 @@ void GradientTexture_DrawVerticalGradient(struct Gradient* gradient, float2 text
 
 void GradientTexture_SetFiltering(struct GradientTexture* texture, GLenum mode);
 
+/**
+ * @brief Draw the gradient shapes with the gradient texture (default) or with per vertex colors
+ */
+void GradientTexture_UseGradientTextures(bool enabled);
+
+// What a cached background was drawn with
+struct GradientBackgroundKey
+{
+    const struct Gradient* gradient;
+    unsigned int gradient_version;
+    enum GradientShape shape;
+    enum GradientLoopMode loop_mode;
+    float repeats;
+    float alpha;
+    float size;
+    float offset;
+    float modelview[16];
+    float projection[16];
+    // The copy takes the whole screen, so also what was cleared around the gradient
+    color3 clear_color;
+    int width;
+    int height;
+};
+
+/**
+ * @brief A gradient background copied into a texture after it has been drawn
+ */
+struct GradientBackground
+{
+    GLuint texture_name;
+    int texture_width;
+    int texture_height;
+    struct GradientBackgroundKey key;
+    bool valid;
+
+    // Frames the gradient was drawn and frames the texture was used instead
+    int redraws;
+    int reuses;
+};
+
+struct GradientBackground GradientBackground_CreateEmpty(void);
+
+/**
+ * @brief Draw the gradient again on next use
+ */
+void GradientBackground_Invalidate(struct GradientBackground* background);
+
+/**
+ * @brief GradientTexture_DrawGradient for a background that often stays the same.
+ * The first draw is copied from the framebuffer into a texture, later calls with the same
+ * gradient, parameters and matrices draw the texture on the screen instead.
+ * Must be the first thing drawn in the frame, the copy takes everything on the screen.
+ * @param clear_color What the screen was cleared to before the gradient, part of the copy
+ * @return True if the gradient was drawn, false if the cached texture was used
+ */
+bool GradientTexture_DrawBackground(struct GradientBackground* background, struct Gradient* gradient,
+                                    enum GradientAlphaMode alphamode, float size, float offset,
+                                    color3 clear_color);
+
 
 
 #endif
@@ -3,6 +3,7 @@
 
 #include "koch_flake.h"
 #include <math.h>
+#include <stdlib.h>
 #include <m_float2_math.h>
 #include <opengl_include.h>
 #include <wii_memory_functions.h>
@@ -145,53 +146,496 @@ void draw_snowflake(float2 center, float radius, short recursion, float angle, f
     glEnd();
 }
 
+// Scratch polylines of the iterative generator, x and y in separate arrays
+static float* koch_scratch = NULL;
+static int koch_scratch_points = 0;
+
+static bool reserve_koch_scratch(int points)
+{
+    if (points <= koch_scratch_points)
+    {
+        return true;
+    }
+    // Two polylines of x and y
+    float* scratch = (float*)realloc(koch_scratch, sizeof(float) * points * 4);
+    if (scratch == NULL)
+    {
+        return false;
+    }
+    koch_scratch = scratch;
+    koch_scratch_points = points;
+    return true;
+}
+
+/**
+ * @brief Triangles of one recursion level over every segment of a polyline.
+ * m1 and m2 divide each segment by ratio, m3 is m1 + rotated (m2 - m1) * extrusion.
+ * Straight SoA loop without calls, compilers with a vector unit vectorize it.
+ * @param x, y Polyline of count + 1 points
+ * @param nx, ny Polyline of the next level, 4 * count + 1 points: A m1 m3 m2 per segment
+ */
+static void koch_level_kernel(const float* restrict x, const float* restrict y, int count,
+    float ratio, float cos_ext, float sin_ext,
+    float* restrict nx, float* restrict ny)
+{
+    const float far_ratio = 1.0f - ratio;
+    for (int i = 0; i < count; i++)
+    {
+        const float ax = x[i];
+        const float ay = y[i];
+        const float dx = x[i + 1] - ax;
+        const float dy = y[i + 1] - ay;
+        const float m1x = ax + dx * ratio;
+        const float m1y = ay + dy * ratio;
+        nx[i * 4 + 0] = ax;
+        ny[i * 4 + 0] = ay;
+        nx[i * 4 + 1] = m1x;
+        ny[i * 4 + 1] = m1y;
+        nx[i * 4 + 2] = m1x + dx * cos_ext - dy * sin_ext;
+        ny[i * 4 + 2] = m1y + dx * sin_ext + dy * cos_ext;
+        nx[i * 4 + 3] = ax + dx * far_ratio;
+        ny[i * 4 + 3] = ay + dy * far_ratio;
+    }
+    nx[count * 4] = x[count];
+    ny[count * 4] = y[count];
+}
+
+static float* write_vertex(float* positions, float x, float y)
+{
+    positions[0] = x;
+    positions[1] = y;
+    positions[2] = 0.0f;
+    return positions + 3;
+}
+
 void KochFlake_WriteToMesh(struct KochFlake* flake, struct Mesh* mesh)
 {
-    store_snowflake_struct(flake);
-    int vertices = flake->recursive_list.used_size;
+    const short levels = M_MAX(flake->recursion_level, 0);
+    // The corner triangle and 3 * 4^level triangles per level
+    const int vertices = 3 << (2 * levels);
+    // The kernel also writes the polyline after the last level
+    const int max_points = (3 << (2 * levels)) + 1;
+
+    if (mesh->positions != NULL && mesh->allocated_vertex_count < vertices)
+    {
+        // Mesh_Allocate does not grow existing buffers, indices follow the positions
+        free(mesh->positions);
+        free(mesh->indices);
+        mesh->positions = NULL;
+        mesh->indices = NULL;
+        mesh->allocated_vertex_count = 0;
+    }
+    mesh->index_count = 0;
     Mesh_Allocate(mesh, vertices, (AttributePosition));
-    if (mesh->positions == NULL)
+    if (mesh->positions == NULL || !reserve_koch_scratch(max_points))
     {
         printf("Mesh not allocated!");
         return;
     }
-    for(int i = 0; i < vertices; i++)
+
+    // Same for every level: m3 - m1 is the segment scaled by (1 - 2 ratio) * extrusion and rotated
+    const float radians = flake->angle * M_DEG_TO_RAD;
+    const float extrusion = flake->extrusion * (1.0f - 2.0f * flake->ratio);
+    const float cos_ext = cosf(radians) * extrusion;
+    const float sin_ext = sinf(radians) * extrusion;
+
+    float* x = koch_scratch;
+    float* y = koch_scratch + koch_scratch_points;
+    float* nx = koch_scratch + koch_scratch_points * 2;
+    float* ny = koch_scratch + koch_scratch_points * 3;
+
+    float2 corners[3];
+    get_corners(flake->center, 3, flake->radius, flake->angle, corners);
+    float* out = mesh->positions;
+    for (int i = 0; i < 3; i++)
+    {
+        out = write_vertex(out, corners[i].x, corners[i].y);
+    }
+
+    // Closed polyline along the edges 2-1, 1-0 and 0-2
+    x[0] = corners[2].x; y[0] = corners[2].y;
+    x[1] = corners[1].x; y[1] = corners[1].y;
+    x[2] = corners[0].x; y[2] = corners[0].y;
+    x[3] = corners[2].x; y[3] = corners[2].y;
+    int count = 3;
+
+    for (short level = 0; level < levels; level++)
     {
-    //printf("Writing flake to mesh: %d vertices in list\n", vertices);
-        float2 p = flake->recursive_list.points[i];
-        int float_index = i * 3;
-        mesh->positions[float_index+0] = p.x;
-        mesh->positions[float_index+1] = p.y;
-        mesh->positions[float_index+2] = 0.0f;
+        koch_level_kernel(x, y, count, flake->ratio, cos_ext, sin_ext, nx, ny);
+        // Triangle m1 m2 m3 of each segment
+        for (int i = 0; i < count; i++)
+        {
+            const int p = i * 4;
+            out = write_vertex(out, nx[p + 1], ny[p + 1]);
+            out = write_vertex(out, nx[p + 3], ny[p + 3]);
+            out = write_vertex(out, nx[p + 2], ny[p + 2]);
+        }
+        if (level + 1 < levels)
+        {
+            float* swap_x = x;
+            float* swap_y = y;
+            x = nx;
+            y = ny;
+            nx = swap_x;
+            ny = swap_y;
+            count *= 4;
+        }
     }
     FlushGPUCache(mesh->positions, mesh->allocated_vertex_count * sizeof(float) * 3);
 }
 
+// Column major like glGetFloatv
+static float4 transform_column_major(const float* m, float4 v)
+{
+    float4 r;
+    r.x = m[0] * v.x + m[4] * v.y + m[8] * v.z + m[12] * v.w;
+    r.y = m[1] * v.x + m[5] * v.y + m[9] * v.z + m[13] * v.w;
+    r.z = m[2] * v.x + m[6] * v.y + m[10] * v.z + m[14] * v.w;
+    r.w = m[3] * v.x + m[7] * v.y + m[11] * v.z + m[15] * v.w;
+    return r;
+}
+
+static float2 project_to_pixels(const float* modelview, const float* projection, float x, float y)
+{
+    float4 v = {x, y, 0.0f, 1.0f};
+    v = transform_column_major(projection, transform_column_major(modelview, v));
+    float w = fabsf(v.w) > 1e-6f ? v.w : 1e-6f;
+    float2 pixels = {
+        v.x / w * ctoy_frame_buffer_width() * 0.5f,
+        v.y / w * ctoy_frame_buffer_height() * 0.5f
+    };
+    return pixels;
+}
+
+float KochFlake_ProjectedRadius(float radius)
+{
+    float modelview[16];
+    float projection[16];
+    glGetFloatv(GL_MODELVIEW_MATRIX, modelview);
+    glGetFloatv(GL_PROJECTION_MATRIX, projection);
+
+    float2 center = project_to_pixels(modelview, projection, 0.0f, 0.0f);
+    float2 right = project_to_pixels(modelview, projection, radius, 0.0f);
+    float2 up = project_to_pixels(modelview, projection, 0.0f, radius);
+    float2 to_right;
+    float2 to_up;
+    M_SUB2(to_right, right, center);
+    M_SUB2(to_up, up, center);
+    return M_MAX(M_LENGHT2(to_right), M_LENGHT2(to_up));
+}
+
+short KochFlake_SelectLOD(float screen_radius)
+{
+    // Edges are sqrt(3) * radius long and every level divides them roughly in three
+    float segment = screen_radius * 1.7320508f;
+    short level = 0;
+    while (level < KOCH_LOD_MAX_LEVEL && segment > KOCH_LOD_SEGMENT_PIXELS)
+    {
+        segment /= 3.0f;
+        level++;
+    }
+    return level;
+}
+
+static int quantize(float value)
+{
+    return (int)floorf(value * KOCH_MESH_CACHE_STEPS + 0.5f);
+}
+
+static float dequantize(int value)
+{
+    return (float)value / KOCH_MESH_CACHE_STEPS;
+}
+
+// Open addressing table of welded vertex ids, -1 is empty
+static int* weld_table = NULL;
+static int weld_table_size = 0;
+
+static unsigned int weld_hash(int x, int y)
+{
+    return ((unsigned int)x * 73856093u) ^ ((unsigned int)y * 19349663u);
+}
+
+// Welding does not depend on center and radius, only on the morph
+struct KochWeldMemo
+{
+    int ratio;
+    int angle;
+    int extrusion;
+    short clean_level; // Deepest level that welded nothing, -1 if unknown
+    bool used;
+};
+
+static struct KochWeldMemo weld_memo[KOCH_WELD_MEMO_SIZE];
+static int weld_memo_next = 0;
+
+static struct KochWeldMemo* koch_weld_memo(struct KochFlake* flake)
+{
+    const int ratio = quantize(flake->ratio);
+    const int angle = quantize(flake->angle);
+    const int extrusion = quantize(flake->extrusion);
+    for (int i = 0; i < KOCH_WELD_MEMO_SIZE; i++)
+    {
+        struct KochWeldMemo* memo = &weld_memo[i];
+        if (memo->used && memo->ratio == ratio && memo->angle == angle && memo->extrusion == extrusion)
+        {
+            return memo;
+        }
+    }
+    struct KochWeldMemo* memo = &weld_memo[weld_memo_next];
+    weld_memo_next = (weld_memo_next + 1) % KOCH_WELD_MEMO_SIZE;
+    memo->ratio = ratio;
+    memo->angle = angle;
+    memo->extrusion = extrusion;
+    memo->clean_level = -1;
+    memo->used = true;
+    return memo;
+}
+
+int KochFlake_WriteToMeshIndexed(struct KochFlake* flake, struct Mesh* mesh)
+{
+    KochFlake_WriteToMesh(flake, mesh);
+    const int vertices = mesh->vertex_count;
+    struct KochWeldMemo* memo = koch_weld_memo(flake);
+    if (mesh->positions == NULL || vertices > 65536 || flake->recursion_level <= memo->clean_level)
+    {
+        mesh->index_count = 0;
+        return vertices;
+    }
+
+    int table_size = 1;
+    while (table_size < vertices * 2)
+    {
+        table_size *= 2;
+    }
+    if (table_size > weld_table_size)
+    {
+        int* table = (int*)realloc(weld_table, sizeof(int) * table_size);
+        if (table == NULL)
+        {
+            mesh->index_count = 0;
+            return vertices;
+        }
+        weld_table = table;
+        weld_table_size = table_size;
+    }
+    for (int i = 0; i < table_size; i++)
+    {
+        weld_table[i] = -1;
+    }
+
+    // Index of every soup vertex, kept in the scratch polyline memory
+    if (!reserve_koch_scratch(vertices))
+    {
+        mesh->index_count = 0;
+        return vertices;
+    }
+    int* remap = (int*)koch_scratch;
+
+    // Compact unique vertices to the front, ids below unique are already final
+    const float step = 1.0f / (KOCH_WELD_EPSILON * M_MAX(fabsf(flake->radius), 1e-6f));
+    float* p = mesh->positions;
+    int unique = 0;
+    for (int i = 0; i < vertices; i++)
+    {
+        const float x = p[i * 3 + 0];
+        const float y = p[i * 3 + 1];
+        const int qx = (int)floorf(x * step + 0.5f);
+        const int qy = (int)floorf(y * step + 0.5f);
+        unsigned int slot = weld_hash(qx, qy) & (table_size - 1);
+        int id = -1;
+        while (weld_table[slot] >= 0)
+        {
+            const int candidate = weld_table[slot];
+            if ((int)floorf(p[candidate * 3 + 0] * step + 0.5f) == qx
+                && (int)floorf(p[candidate * 3 + 1] * step + 0.5f) == qy)
+            {
+                id = candidate;
+                break;
+            }
+            slot = (slot + 1) & (table_size - 1);
+        }
+        if (id < 0)
+        {
+            id = unique++;
+            weld_table[slot] = id;
+            p[id * 3 + 0] = x;
+            p[id * 3 + 1] = y;
+            p[id * 3 + 2] = 0.0f;
+        }
+        remap[i] = id;
+    }
+
+    if (unique == vertices)
+    {
+        memo->clean_level = M_MAX(memo->clean_level, flake->recursion_level);
+        mesh->index_count = 0;
+        return vertices;
+    }
+
+    if (mesh->indices == NULL)
+    {
+        // Index capacity follows the position buffer
+        mesh->indices = (unsigned short*)AllocateGPUMemory(sizeof(unsigned short) * mesh->allocated_vertex_count);
+        if (mesh->indices == NULL)
+        {
+            // Positions are already compacted, regenerate the soup
+            KochFlake_WriteToMesh(flake, mesh);
+            mesh->index_count = 0;
+            return vertices;
+        }
+    }
+    for (int i = 0; i < vertices; i++)
+    {
+        mesh->indices[i] = (unsigned short)remap[i];
+    }
+    mesh->vertex_count = unique;
+    mesh->index_count = vertices;
+    FlushGPUCache(mesh->positions, unique * sizeof(float) * 3);
+    FlushGPUCache(mesh->indices, vertices * sizeof(unsigned short));
+    return vertices;
+}
+
+static struct KochMeshKey KochMeshKey_Create(struct KochFlake* flake)
+{
+    struct KochMeshKey key;
+    key.center_x = quantize(flake->center.x);
+    key.center_y = quantize(flake->center.y);
+    key.radius = quantize(flake->radius);
+    key.ratio = quantize(flake->ratio);
+    key.angle = quantize(flake->angle);
+    key.extrusion = quantize(flake->extrusion);
+    key.recursion_level = flake->recursion_level;
+    return key;
+}
+
+static bool KochMeshKey_Equal(struct KochMeshKey* a, struct KochMeshKey* b)
+{
+    return a->center_x == b->center_x && a->center_y == b->center_y
+        && a->radius == b->radius && a->ratio == b->ratio
+        && a->angle == b->angle && a->extrusion == b->extrusion
+        && a->recursion_level == b->recursion_level;
+}
+
+void KochMeshCache_Init(struct KochMeshCache* cache)
+{
+    for (int i = 0; i < KOCH_MESH_CACHE_SIZE; i++)
+    {
+        cache->entries[i].mesh = Mesh_CreateEmpty();
+        cache->entries[i].last_used = 0;
+        cache->entries[i].valid = false;
+    }
+    cache->clock = 0;
+    cache->hits = 0;
+    cache->misses = 0;
+}
+
+static int koch_mesh_bytes(struct Mesh* mesh)
+{
+    int bytes = 0;
+    if (mesh->positions != NULL)
+    {
+        bytes += sizeof(float) * 3 * mesh->allocated_vertex_count;
+    }
+    if (mesh->indices != NULL)
+    {
+        bytes += sizeof(unsigned short) * mesh->allocated_vertex_count;
+    }
+    return bytes;
+}
+
+static void koch_mesh_free(struct KochMeshCacheEntry* entry)
+{
+    free(entry->mesh.positions);
+    free(entry->mesh.indices);
+    entry->mesh = Mesh_CreateEmpty();
+    entry->valid = false;
+}
+
+// Free least recently used meshes other than keep until the cache fits its budget
+static void koch_mesh_cache_trim(struct KochMeshCache* cache, struct KochMeshCacheEntry* keep)
+{
+    int bytes = 0;
+    for (int i = 0; i < KOCH_MESH_CACHE_SIZE; i++)
+    {
+        bytes += koch_mesh_bytes(&cache->entries[i].mesh);
+    }
+    while (bytes > KOCH_MESH_CACHE_MAX_BYTES)
+    {
+        struct KochMeshCacheEntry* oldest = NULL;
+        for (int i = 0; i < KOCH_MESH_CACHE_SIZE; i++)
+        {
+            struct KochMeshCacheEntry* entry = &cache->entries[i];
+            if (entry != keep && koch_mesh_bytes(&entry->mesh) > 0
+                && (oldest == NULL || entry->last_used < oldest->last_used))
+            {
+                oldest = entry;
+            }
+        }
+        if (oldest == NULL)
+        {
+            return;
+        }
+        bytes -= koch_mesh_bytes(&oldest->mesh);
+        koch_mesh_free(oldest);
+    }
+}
+
+struct Mesh* KochMeshCache_Get(struct KochMeshCache* cache, struct KochFlake* flake)
+{
+    struct KochMeshKey key = KochMeshKey_Create(flake);
+    struct KochMeshCacheEntry* oldest = &cache->entries[0];
+    cache->clock++;
+
+    for (int i = 0; i < KOCH_MESH_CACHE_SIZE; i++)
+    {
+        struct KochMeshCacheEntry* entry = &cache->entries[i];
+        if (entry->valid && KochMeshKey_Equal(&entry->key, &key))
+        {
+            entry->last_used = cache->clock;
+            cache->hits++;
+            return &entry->mesh;
+        }
+        if (!entry->valid || (oldest->valid && entry->last_used < oldest->last_used))
+        {
+            oldest = entry;
+        }
+    }
+
+    // Generate from the rounded values so the mesh does not depend on which value filled the entry
+    KochFlake quantized = *flake;
+    quantized.center.x = dequantize(key.center_x);
+    quantized.center.y = dequantize(key.center_y);
+    quantized.radius = dequantize(key.radius);
+    quantized.ratio = dequantize(key.ratio);
+    quantized.angle = dequantize(key.angle);
+    quantized.extrusion = dequantize(key.extrusion);
+    KochFlake_WriteToMeshIndexed(&quantized, &oldest->mesh);
+
+    oldest->key = key;
+    oldest->last_used = cache->clock;
+    oldest->valid = true;
+    cache->misses++;
+    koch_mesh_cache_trim(cache, oldest);
+    return &oldest->mesh;
+}
+
+float KochMeshCache_HitRate(struct KochMeshCache* cache)
+{
+    int lookups = cache->hits + cache->misses;
+    if (lookups == 0)
+    {
+        return 0.0f;
+    }
+    return (float)cache->hits / (float)lookups;
+}
+
 struct KochFlake KochFlake_CreateDefault(short recursion_level)
 {
     KochFlake flake;
-    int needed_size = 3;
-    switch(recursion_level)
-    {
-        case 0:
-        needed_size = 3;
-        break;
-        case 1:
-            needed_size = 12;
-            break;
-        case 2:
-            needed_size = 48;
-            break;
-        case 3:
-            needed_size = 192;
-            break;
-        case 4:
-            needed_size = 768;
-            break;
-        case 5:
-            needed_size = 3072;
-            break;
-    }
+    // Points of the recursive path, KochFlake_WriteToMesh does not need the list
+    int level = M_MAX(recursion_level, 0);
+    int needed_size = level < 6 ? (3 << (2 * level)) : POINT_LIST_MAX_SIZE;
 
 	flake.recursive_list = PointList_create(needed_size);
 
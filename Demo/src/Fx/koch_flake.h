@@ -23,6 +23,90 @@ void KochFlake_SetMorphToDefault(struct KochFlake* flake);
 
 void KochFlake_WriteToMesh(struct KochFlake* flake, struct Mesh* mesh);
 
+// Vertices closer than this times the radius are welded
+#define KOCH_WELD_EPSILON 1e-5f
+// Morphs that remember which levels weld nothing
+#define KOCH_WELD_MEMO_SIZE 8
+
+/**
+ * @brief Same flake as KochFlake_WriteToMesh, with coinciding vertices merged through mesh->indices.
+ * Stays non-indexed when nothing coincides, which is the case for the default morph:
+ * the triangles of the next level sit inside the segments and share no corners.
+ * Levels with the same morph only add triangles, so the deepest level known to
+ * weld nothing is remembered per morph and levels up to it skip the weld pass.
+ * tools/koch_weld_stats prints the counts per level.
+ * @return Vertex count before welding
+ */
+int KochFlake_WriteToMeshIndexed(struct KochFlake* flake, struct Mesh* mesh);
+
+// Deepest recursion level of the LOD meshes, 3 * 4^6 vertices.
+// Enough for 3 pixel segments on a flake of 640 pixels radius.
+#define KOCH_LOD_MAX_LEVEL 6
+// The selected level is the first with segments shorter than this on screen
+#define KOCH_LOD_SEGMENT_PIXELS 3.0f
+
+/**
+ * @brief Radius in pixels of a flake of radius at the origin, under the current GL matrices
+ */
+float KochFlake_ProjectedRadius(float radius);
+
+/**
+ * @brief Recursion level 0 - KOCH_LOD_MAX_LEVEL that gives enough detail at the size on screen
+ * @param screen_radius Radius in pixels, from KochFlake_ProjectedRadius
+ */
+short KochFlake_SelectLOD(float screen_radius);
+
+#define KOCH_MESH_CACHE_SIZE 16
+// Least recently used meshes are freed when the cached buffers grow over this
+#define KOCH_MESH_CACHE_MAX_BYTES (1024 * 1024)
+// Flake parameters are rounded to steps of 1/KOCH_MESH_CACHE_STEPS before comparing
+#define KOCH_MESH_CACHE_STEPS 1024.0f
+
+struct KochMeshKey
+{
+    int center_x;
+    int center_y;
+    int radius;
+    int ratio;
+    int angle;
+    int extrusion;
+    short recursion_level;
+};
+
+struct KochMeshCacheEntry
+{
+    struct KochMeshKey key;
+    struct Mesh mesh;
+    unsigned int last_used;
+    bool valid;
+};
+
+/**
+ * @brief Ready flake meshes of recently used parameters, least recently used is replaced.
+ * At most KOCH_MESH_CACHE_SIZE meshes and KOCH_MESH_CACHE_MAX_BYTES of buffers.
+ */
+struct KochMeshCache
+{
+    struct KochMeshCacheEntry entries[KOCH_MESH_CACHE_SIZE];
+    unsigned int clock;
+    int hits;
+    int misses;
+};
+
+void KochMeshCache_Init(struct KochMeshCache* cache);
+
+/**
+ * @brief Welded mesh of the flake at the quantized parameters, generated only when not cached
+ * @param flake Parameters of the flake
+ * @return Mesh owned by the cache, valid until the next KochMeshCache_Get
+ */
+struct Mesh* KochMeshCache_Get(struct KochMeshCache* cache, struct KochFlake* flake);
+
+/**
+ * @brief Hits per lookup since init, 0 without lookups
+ */
+float KochMeshCache_HitRate(struct KochMeshCache* cache);
+
 /**
  * @brief Recursively calculate the points on the line and draw the triangle
  * @param A Point A of line
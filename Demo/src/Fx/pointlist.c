@@ -1,5 +1,6 @@
 #include "pointlist.h"
 #include <opengl_include.h>
+#include <stdio.h>
 
 PointList PointList_create(int size)
 {
@@ -11,13 +12,22 @@ PointList PointList_create(int size)
 }
 
 
-void PointList_reserve(PointList* list, int new_size)
+bool PointList_reserve(PointList* list, int new_size)
 {
     if (list->allocated_size < new_size)
     {
-        list->points = (float2*)realloc(list->points, sizeof(float2) * new_size);
-        list->allocated_size = new_size;
+        // Lists that grow a bit every frame double, so they are not copied every frame
+        const int grown_size = M_MAX(new_size, list->allocated_size * 2);
+        float2* points = (float2*)realloc(list->points, sizeof(float2) * grown_size);
+        if (points == NULL)
+        {
+            printf("Point list of %d points not allocated!\n", grown_size);
+            return false;
+        }
+        list->points = points;
+        list->allocated_size = grown_size;
     }
+    return true;
 }
 
 void PointList_clear(PointList* list)
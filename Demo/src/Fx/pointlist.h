@@ -1,6 +1,7 @@
 #ifndef POINTLIST_H
 #define POINTLIST_H
 
+#include <stdbool.h>
 #include <m_math.h>
 
 #define POINT_LIST_MAX_SIZE 4096
@@ -16,11 +17,12 @@ typedef struct PointList PointList;
 PointList PointList_create(int size);
 
 /**
- * @brief Ensure that list can hold at least new_size points
+ * @brief Ensure that list can hold at least new_size points, grows at least by doubling
  * @param list The list
  * @param new_size New minimum size
+ * @return False if the allocation failed, the list keeps its old points and size
  */
-void PointList_reserve(PointList* list, int new_size);
+bool PointList_reserve(PointList* list, int new_size);
 
 void PointList_clear(PointList* list);
 
@@ -37,20 +37,16 @@ void rotation_fx(
         screenprintf("PG %.1f\n", progression);
 
         get_corners(zero2, 6, size/2, progression * move_amount, outerCenters);
+        float transforms[6 * 6];
+        color3 colors[6];
         for (int i = 0; i < 6; i++)
         {
             float2 ringcenter = outerCenters[i];
-            glPushMatrix();
-                glTranslatef(ringcenter.x, ringcenter.y, 0.0f);
-                glRotatef(progression * move_amount * -1.0f, 0.0f, 0.0f, 1.0f);
-
-                glScalef(size*0.5f, size*0.5f, 1.0f);
-                glColor3f(fore.r, fore.g, fore.b);
-                Mesh_Draw(flake4, DrawTriangles);
-                //glColor3f(1.0f, 1.0f, 1.0f);
-
-            glPopMatrix();
+            Mesh_SetTransform2D(&transforms[i * 6], ringcenter.x, ringcenter.y,
+                                progression * move_amount * -1.0f, size * 0.5f);
+            colors[i] = fore;
         }
+        Mesh_DrawInstances(flake4, transforms, colors, 6);
     }
     else
     {
@@ -62,28 +58,13 @@ void rotation_fx(
         float pn = (progress_normalized - 0.5f) * 2.0f;
         float progression = 1.0f - (1.0f - pn) * (1.0f - pn);
         screenprintf("PG %.1f\n", progression);
-        glPushMatrix();
-
-            // Big flake behind
-            glPushMatrix();
-                glColor3f(fore.r, fore.g, fore.b);
-                glRotatef(30.0f + progression * move_amount * -1.0f, 0.0f, 0.0f, 1.0f);
-                glScalef(size, size, 1.0f);
-                Mesh_Draw(flake4, DrawTriangles);
-            glPopMatrix();
-
-            // Smol in front
-
-            //glColor3f(1.0f, 1.0f, 1.0f);
 
-            glPushMatrix();
-                glColor3f(back.r, back.g, back.b);
-                glRotatef(progression*move_amount, 0.0f, 0.0f, 1.0f);
-                glScalef(inner_size, inner_size, 1.0f);
-                Mesh_Draw(flake4, DrawTriangles);
-            glPopMatrix();
-            //glColor3f(1.0f, 1.0f, 1.0f);
-        glPopMatrix();
+        // Big flake behind, smol in front
+        float transforms[2 * 6];
+        color3 colors[2] = {fore, back};
+        Mesh_SetTransform2D(&transforms[0], 0.0f, 0.0f, 30.0f + progression * move_amount * -1.0f, size);
+        Mesh_SetTransform2D(&transforms[6], 0.0f, 0.0f, progression * move_amount, inner_size);
+        Mesh_DrawInstances(flake4, transforms, colors, 2);
     }
 }
 
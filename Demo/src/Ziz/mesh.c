@@ -5,6 +5,11 @@
 #include <m_float2_math.h>
 #include "screenprint.h"
 
+#if defined(__SSE__) || defined(_M_X64)
+#include <xmmintrin.h>
+#define MESH_USE_SSE
+#endif
+
 struct Mesh Mesh_CreateEmpty(void)
 {
     struct Mesh mesh;
@@ -12,6 +17,7 @@ struct Mesh Mesh_CreateEmpty(void)
     mesh.normals = NULL;
     mesh.texcoords = NULL;
     mesh.vertex_count = 0;
+    mesh.allocated_vertex_count = 0;
     mesh.indices = NULL;
     mesh.index_count = 0;
     mesh.enabled_attributes = 0;
@@ -164,7 +170,7 @@ static int Calculate_Percentage(int vertex_count, int percentage)
 static void Mesh_DrawElements(struct Mesh* mesh, int percentage)
 {
     Setup_Arrays(mesh);
-    int draw_amount = Calculate_Percentage(mesh->vertex_count, percentage);
+    int draw_amount = Calculate_Percentage(mesh->index_count, percentage);
 	glDrawElements(GL_TRIANGLES, draw_amount, GL_UNSIGNED_SHORT, mesh->indices);
     Disable_Arrays(mesh);
 
@@ -217,6 +223,115 @@ void Mesh_DrawPartial(struct Mesh* mesh, enum MeshDrawMode mode, int percentage)
 
 }
 
+// Expanded vertices of Mesh_DrawInstances, grows up to MESH_INSTANCE_BATCH_VERTICES
+static float* instance_positions = NULL;
+static unsigned char* instance_colors = NULL;
+static int instance_capacity = 0;
+static struct MeshDrawStats draw_stats = {0, 0};
+
+void Mesh_SetTransform2D(float* transform, float x, float y, float degrees, float scale)
+{
+    const float radians = degrees * M_DEG_TO_RAD;
+    const float c = cosf(radians) * scale;
+    const float s = sinf(radians) * scale;
+    transform[0] = c;
+    transform[1] = s;
+    transform[2] = -s;
+    transform[3] = c;
+    transform[4] = x;
+    transform[5] = y;
+}
+
+// Draw what the instance buffers hold and start over
+static void draw_instance_chunk(int count)
+{
+    FlushGPUCache(instance_positions, sizeof(float) * 3 * count);
+    FlushGPUCache(instance_colors, 4 * count);
+    glDrawArrays(GL_TRIANGLES, 0, count);
+    draw_stats.draw_calls++;
+}
+
+void Mesh_DrawInstances(struct Mesh* mesh, const float* transforms2d, const color3* colors, int n)
+{
+    const bool indexed = mesh->indices != NULL && mesh->index_count > 0;
+    const int per_instance = indexed ? mesh->index_count : mesh->vertex_count;
+    const int total = per_instance * n;
+    if (total <= 0 || mesh->positions == NULL)
+    {
+        return;
+    }
+
+    // Both counts are whole triangles, so chunks never split one
+    const int capacity = M_MIN(total, MESH_INSTANCE_BATCH_VERTICES);
+    if (capacity > instance_capacity)
+    {
+        free(instance_positions);
+        free(instance_colors);
+        instance_positions = (float*)AllocateGPUMemory(sizeof(float) * 3 * capacity);
+        instance_colors = (unsigned char*)AllocateGPUMemory(4 * capacity);
+        instance_capacity = capacity;
+        if (instance_positions == NULL || instance_colors == NULL)
+        {
+            printf("Instance buffers not allocated!\n");
+            instance_capacity = 0;
+            return;
+        }
+    }
+
+    glEnableClientState(GL_VERTEX_ARRAY);
+    glEnableClientState(GL_COLOR_ARRAY);
+    glVertexPointer(3, GL_FLOAT, 0, instance_positions);
+    glColorPointer(4, GL_UNSIGNED_BYTE, 0, instance_colors);
+
+    const int draws_before = draw_stats.draw_calls;
+    const float* positions = mesh->positions;
+    const unsigned short* indices = indexed ? mesh->indices : NULL;
+    int used = 0;
+    for (int i = 0; i < n; i++)
+    {
+        const float* t = transforms2d + i * 6;
+        const float a = t[0], b = t[1], c = t[2], d = t[3], x = t[4], y = t[5];
+        // One RGBA8 word per vertex instead of three floats
+        const unsigned int color = ColorManager_ToRGBA8(colors[i]);
+        int v = 0;
+        while (v < per_instance)
+        {
+            if (used == capacity)
+            {
+                draw_instance_chunk(used);
+                used = 0;
+            }
+            const int end = M_MIN(per_instance, v + capacity - used);
+            float* restrict out = instance_positions + used * 3;
+            unsigned int* restrict out_color = (unsigned int*)instance_colors + used;
+            used += end - v;
+            for (; v < end; v++)
+            {
+                const float* p = positions + (indices != NULL ? indices[v] : v) * 3;
+                out[0] = a * p[0] + c * p[1] + x;
+                out[1] = b * p[0] + d * p[1] + y;
+                out[2] = p[2];
+                *out_color++ = color;
+                out += 3;
+            }
+        }
+    }
+    draw_instance_chunk(used);
+
+    glDisableClientState(GL_COLOR_ARRAY);
+    glDisableClientState(GL_VERTEX_ARRAY);
+
+    draw_stats.draw_calls_saved += n - (draw_stats.draw_calls - draws_before);
+}
+
+struct MeshDrawStats Mesh_TakeDrawStats(void)
+{
+    struct MeshDrawStats stats = draw_stats;
+    draw_stats.draw_calls = 0;
+    draw_stats.draw_calls_saved = 0;
+    return stats;
+}
+
 void Mesh_PrintInfo(struct Mesh* mesh, bool to_screen)
 {
     if (mesh->positions != NULL)
@@ -258,14 +373,77 @@ void Mesh_EnableAttribute(struct Mesh* mesh, enum VertexAttribute attrib)
     mesh->enabled_attributes = (mesh->enabled_attributes | attrib);
 }
 
-static float3 reflect_3d(float3 N, float3 source)
+// Vertices per block of Mesh_GenerateMatcapUVs
+#define MATCAP_BLOCK 64
+
+/**
+ * @brief Eye space positions and normals of a block of vertices, one array per component.
+ * The normals are not normalized, the UV formula does not need it.
+ */
+struct MatcapBlock
 {
-    float3 dest;
-    float dot = M_DOT3(N, source);
-    float3 reflect;
-    M_SCALE3(reflect, N, (dot*2.0f));
-    M_SUB3(dest, source, reflect);
-    return dest;
+    float px[MATCAP_BLOCK];
+    float py[MATCAP_BLOCK];
+    float pz[MATCAP_BLOCK];
+    float nx[MATCAP_BLOCK];
+    float ny[MATCAP_BLOCK];
+    float nz[MATCAP_BLOCK];
+};
+
+/**
+ * @brief Matcap UVs of a block, written as u v pairs.
+ * The eye vector p reflected by normal n is q = p - 2 (p.n / n.n) n, which has the length of p.
+ * With r = q / |p| the UV is r.xy / (2 |r + (0,0,1)|) + 0.5, which simplifies to
+ * q.xy / (2 sqrt(qx^2 + qy^2 + (qz + |p|)^2)) + 0.5, v flipped.
+ */
+static void matcap_block_uvs(const struct MatcapBlock* b, float* texcoords, int n)
+{
+    int i = 0;
+#if defined(MESH_USE_SSE)
+    const __m128 zero = _mm_setzero_ps();
+    const __m128 half = _mm_set1_ps(0.5f);
+    const __m128 two = _mm_set1_ps(2.0f);
+    for (; i + 4 <= n; i += 4)
+    {
+        __m128 px = _mm_loadu_ps(b->px + i);
+        __m128 py = _mm_loadu_ps(b->py + i);
+        __m128 pz = _mm_loadu_ps(b->pz + i);
+        __m128 nx = _mm_loadu_ps(b->nx + i);
+        __m128 ny = _mm_loadu_ps(b->ny + i);
+        __m128 nz = _mm_loadu_ps(b->nz + i);
+        __m128 pp = _mm_add_ps(_mm_add_ps(_mm_mul_ps(px, px), _mm_mul_ps(py, py)), _mm_mul_ps(pz, pz));
+        __m128 nn = _mm_add_ps(_mm_add_ps(_mm_mul_ps(nx, nx), _mm_mul_ps(ny, ny)), _mm_mul_ps(nz, nz));
+        __m128 pn = _mm_add_ps(_mm_add_ps(_mm_mul_ps(px, nx), _mm_mul_ps(py, ny)), _mm_mul_ps(pz, nz));
+        // No normal leaves the eye vector as is
+        __m128 k = _mm_and_ps(_mm_cmpgt_ps(nn, zero), _mm_div_ps(_mm_mul_ps(two, pn), nn));
+        __m128 qx = _mm_sub_ps(px, _mm_mul_ps(k, nx));
+        __m128 qy = _mm_sub_ps(py, _mm_mul_ps(k, ny));
+        __m128 w = _mm_add_ps(_mm_sub_ps(pz, _mm_mul_ps(k, nz)), _mm_sqrt_ps(pp));
+        __m128 d2 = _mm_add_ps(_mm_add_ps(_mm_mul_ps(qx, qx), _mm_mul_ps(qy, qy)), _mm_mul_ps(w, w));
+        // The center of the matcap at the eye or when reflecting straight back
+        __m128 valid = _mm_and_ps(_mm_cmpgt_ps(pp, zero), _mm_cmpgt_ps(d2, zero));
+        __m128 scale = _mm_and_ps(valid, _mm_div_ps(half, _mm_sqrt_ps(d2)));
+        __m128 u = _mm_add_ps(half, _mm_mul_ps(qx, scale));
+        __m128 v = _mm_sub_ps(half, _mm_mul_ps(qy, scale));
+        _mm_storeu_ps(texcoords + i * 2, _mm_unpacklo_ps(u, v));
+        _mm_storeu_ps(texcoords + i * 2 + 4, _mm_unpackhi_ps(u, v));
+    }
+#endif
+    for (; i < n; i++)
+    {
+        const float px = b->px[i], py = b->py[i], pz = b->pz[i];
+        const float nx = b->nx[i], ny = b->ny[i], nz = b->nz[i];
+        const float pp = px * px + py * py + pz * pz;
+        const float nn = nx * nx + ny * ny + nz * nz;
+        const float k = nn > 0.0f ? 2.0f * (px * nx + py * ny + pz * nz) / nn : 0.0f;
+        const float qx = px - k * nx;
+        const float qy = py - k * ny;
+        const float w = pz - k * nz + sqrtf(pp);
+        const float d2 = qx * qx + qy * qy + w * w;
+        const float scale = (pp > 0.0f && d2 > 0.0f) ? 0.5f / sqrtf(d2) : 0.0f;
+        texcoords[i * 2 + 0] = 0.5f + qx * scale;
+        texcoords[i * 2 + 1] = 0.5f - qy * scale;
+    }
 }
 
 void Mesh_GenerateMatcapUVs(struct Mesh* mesh)
@@ -276,158 +454,40 @@ void Mesh_GenerateMatcapUVs(struct Mesh* mesh)
         Mesh_Allocate(mesh, mesh->vertex_count, (AttributeTexcoord));
     }
 
-    float modelView[16] = M_MAT4_IDENTITY();
-    bool transpose = false;
-    {
-        if (transpose)
-        {
-            float modelViewMatrix[16];
-            glGetFloatv(GL_MODELVIEW_MATRIX, modelViewMatrix);
-            m_mat4_transpose(modelView, modelViewMatrix);
-
-           /*
-            screenprint("ModelviewMatrix");
-            screenprintf("[%-0.2f %+.2f %+.2f %+.2f]", modelViewMatrix[0], modelViewMatrix[1], modelViewMatrix[2],modelViewMatrix[3] );
-            screenprintf("[%-0.2f %+.2f %+.2f %+.2f]", modelViewMatrix[4], modelViewMatrix[5], modelViewMatrix[6],modelViewMatrix[7] );
-            screenprintf("[%-0.2f %+.2f %+.2f %+.2f]", modelViewMatrix[8], modelViewMatrix[9], modelViewMatrix[10],modelViewMatrix[11] );
-            screenprintf("[%-.2f %+.2f %+.2f %+.2f]", modelViewMatrix[12], modelViewMatrix[13], modelViewMatrix[14],modelViewMatrix[15] );
-            */
-        }
-        else
-        {
-            glGetFloatv(GL_MODELVIEW_MATRIX, modelView);
-        }
-    }
-    // Copy the values
-
-    // Different ways
-    // Normal
-    // transposed
-
-    /*
-    for (int row = 0; row < 4; row++)
+    float modelView[16];
+    glGetFloatv(GL_MODELVIEW_MATRIX, modelView);
+
+    // Columns of the upper 3x3 and the translation
+    const float3 c0 = {modelView[0], modelView[1], modelView[2]};
+    const float3 c1 = {modelView[4], modelView[5], modelView[6]};
+    const float3 c2 = {modelView[8], modelView[9], modelView[10]};
+    const float3 c3 = {modelView[12], modelView[13], modelView[14]};
+
+    // Normal matrix: the inverse transpose of the 3x3 is its cofactor matrix over the
+    // determinant, the columns below. The length and sign of the normal do not matter.
+    float3 n0;
+    float3 n1;
+    float3 n2;
+    M_CROSS3(n0, c1, c2);
+    M_CROSS3(n1, c2, c0);
+    M_CROSS3(n2, c0, c1);
+
+    struct MatcapBlock block;
+    for (int first = 0; first < mesh->vertex_count; first += MATCAP_BLOCK)
     {
-        for (int col = 0; col < 4; col++)
+        const int count = M_MIN(MATCAP_BLOCK, mesh->vertex_count - first);
+        const float* position = &mesh->positions[first * 3];
+        const float* normal = &mesh->normals[first * 3];
+        for (int i = 0; i < count; i++, position += 3, normal += 3)
         {
-            modelView[row*4+col] = modelViewMatrix[row * 4 + col];
+            block.px[i] = c0.x * position[0] + c1.x * position[1] + c2.x * position[2] + c3.x;
+            block.py[i] = c0.y * position[0] + c1.y * position[1] + c2.y * position[2] + c3.y;
+            block.pz[i] = c0.z * position[0] + c1.z * position[1] + c2.z * position[2] + c3.z;
+            block.nx[i] = n0.x * normal[0] + n1.x * normal[1] + n2.x * normal[2];
+            block.ny[i] = n0.y * normal[0] + n1.y * normal[1] + n2.y * normal[2];
+            block.nz[i] = n0.z * normal[0] + n1.z * normal[1] + n2.z * normal[2];
         }
+        matcap_block_uvs(&block, &mesh->texcoords[first * 2], count);
     }
-    */
-    /*
-    screenprint("Modelview");
-    screenprintf("[%-0.2f %+.2f %+.2f %+.2f]", modelView[0], modelView[1], modelView[2],modelView[3] );
-    screenprintf("[%-0.2f %+.2f %+.2f %+.2f]", modelView[4], modelView[5], modelView[6],modelView[7] );
-    screenprintf("[%-0.2f %+.2f %+.2f %+.2f]", modelView[8], modelView[9], modelView[10],modelView[11] );
-    screenprintf("[%-.2f %+.2f %+.2f %+.2f]", modelView[12], modelView[13], modelView[14],modelView[15] );
-    */
-
-    float inverseView[16] = M_MAT4_IDENTITY();
-    float normalMatrix[16] = M_MAT4_IDENTITY();
-
-    m_mat4_inverse(inverseView, modelView);
-    m_mat4_transpose(normalMatrix, inverseView);
-
-    // Generation
-
-	float3 eye;
-	float3 normal; // screen space normalo
-	float4 normal4;
-	float3 reflection;
-	float2 R2;
-	float3 position;
-	float4 position4;
-	float2 matcapUV;
-
-
-	// Overwrite UVs
-#define VERTICES_PER_FRAME 8092
-
-	const float2 half = {0.5f, 0.5f};
-
-    /*
-    static int update_counter = 0;
-    int target = (update_counter + VERTICES_PER_FRAME);
-    bool restart_counter = false;
-    if (target >= mesh->vertex_count)
-    {
-        target = mesh->vertex_count;
-        restart_counter = true;
-    }
-    */
-
-    int update_counter = 0;
-    int target = mesh->vertex_count;
-    int v = 0;
-    int uv = 0;
-
-    //printf("Target %d\n", target);
-    //printf("writing %d uvs\n", mesh->vertex_count);
-	for (int i = update_counter; i < target; i++)
-	{
-        v = i * 3;
-        uv = i * 2; // DANGER This is important distinction
-
-		position.x = mesh->positions[v+0];
-		position.y = mesh->positions[v+1];
-		position.z = mesh->positions[v+2];
-
-		normal.x = mesh->normals[v+0];
-		normal.y = mesh->normals[v+1];
-		normal.z = mesh->normals[v+2];
-
-		normal4.x = normal.x;
-        normal4.y = normal.y;
-        normal4.z = normal.z;
-        normal4.w = 0.0f;
-
-		position4.x = position.x;
-        position4.y = position.y;
-        position4.z = position.z;
-        position4.w = 1.0f;
-
-		m_mat4_transform4(&position4, modelView, &position4);
-
-        position.x = position4.x;
-        position.y = position4.y;
-        position.z = position4.z;
-
-		matcapUV.x = 0.5f;
-        matcapUV.y = 0.5f;
-		if (M_LENGHT3(position) != 0.0f)
-		{
-			M_NORMALIZE3(eye, position);
-            m_mat4_transform4(&normal4, normalMatrix, &normal4);
-            normal.x = normal4.x;
-            normal.y = normal4.y;
-            normal.z = normal4.z;
-			M_NORMALIZE3(normal, normal);
-
-            reflection = reflect_3d(normal, eye); // Reflect eye with normal
-
-			const float rx2 = pow(reflection.x, 2.0f);
-			const float ry2 = pow(reflection.y, 2.0f);
-			const float rz12 = pow(reflection.z+1, 2.0f);
-			const float sqrtR2 = sqrt(rx2 + ry2 + rz12) * 2.0f;
-            if (sqrtR2 != 0.0f)
-            {
-                R2.x = reflection.x/sqrtR2;
-                R2.y = reflection.y/sqrtR2;
-                M_ADD2(matcapUV, R2, half);
-            }
-		}
-		mesh->texcoords[uv+0] =  matcapUV.x;
-		mesh->texcoords[uv+1] =  1.0f - matcapUV.y;
-	}
 	FlushGPUCache(mesh->texcoords, mesh->vertex_count * sizeof(float) * 2);
-
-    /*
-    if (restart_counter)
-    {
-        update_counter = 0;
-    }
-    else
-    {
-        update_counter = target;
-    }
-    */
 }
@@ -1,6 +1,8 @@
 #ifndef MESH_H
 #define MESH_H
 
+#include "../Fx/color_manager.h"
+
 enum MeshDrawMode
 {
     DrawPoints,
@@ -42,5 +44,33 @@ void Mesh_GenerateMatcapUVs(struct Mesh* mesh);
 void Mesh_Draw(struct Mesh* mesh, enum MeshDrawMode mode);
 void Mesh_DrawPartial(struct Mesh* mesh, enum MeshDrawMode mode, int percentage);
 
+/**
+ * @brief Write a 2D transform for Mesh_DrawInstances: scale, then rotate, then translate
+ * @param transform 6 floats, column major 2x3 like the upper part of a GL matrix
+ */
+void Mesh_SetTransform2D(float* transform, float x, float y, float degrees, float scale);
+
+// Vertices of one instanced draw, larger instance sets are drawn in chunks of this many
+#define MESH_INSTANCE_BATCH_VERTICES 24576
+
+/**
+ * @brief Draw n copies of the mesh with one draw call per MESH_INSTANCE_BATCH_VERTICES.
+ * The instances are expanded on the CPU into one position and color stream, in order.
+ * @param transforms2d n transforms from Mesh_SetTransform2D, applied before the current matrix
+ * @param colors Color of each instance
+ */
+void Mesh_DrawInstances(struct Mesh* mesh, const float* transforms2d, const color3* colors, int n);
+
+struct MeshDrawStats
+{
+    int draw_calls;       // Draw calls made by Mesh_DrawInstances
+    int draw_calls_saved; // Instances that did not need their own Mesh_Draw
+};
+
+/**
+ * @brief Counts since the previous call, call once per frame
+ */
+struct MeshDrawStats Mesh_TakeDrawStats(void);
+
 
 #endif
@@ -34,6 +34,7 @@
 #   include "ufbx/ufbx.h"
 #   include "ufbx/ufbx.c"
 #	include "Fx/ufbx_to_mesh.c"
+#   include "../rocket/rocket_ctoy.h"
 
 #endif
 
@@ -84,12 +85,16 @@ static float rpb = 4.0f;
 #define FAR_PLANE 1000.0f
 #define NEAR_PLANE 0.01f
 
+// Most flakes the tunnel draws
+#define TUNNEL_MAX_SHAPES 32
 
 // Koch flakes
 static KochFlake flake;
 static PointList rotation_outer;
 static PointList wheel_list;
 static struct Mesh flake_mesh_recursion4;
+// Meshes of the morphed flake for the tunnel and wheel
+static struct KochMeshCache flake_mesh_cache;
 
 // Bunny fx
 static struct Bunny bunny_mesh;
@@ -108,14 +113,19 @@ static struct Gradient rainbow_gradient;
 static struct Gradient cold_halo_gradient;
 static struct Gradient warm_halo_gradient;
 static struct Gradient cold_to_warm_gradient;
+// Last background gradient, drawn again only when it changes
+static struct GradientBackground background_cache;
 
 
 // Gosper curve fx
 static PointList gosper_list;
+static struct GosperCurve gosper_curve;
 
 static float gosper_lenght = 5.0f;
-static short gosper_recursion = 3;
+static short gosper_recursion = 5;
 static float gosper_width = 2.0f;
+static bool gosper_from_track = false;
+static double gosper_row = 0.0;
 
 
 // Demo status
@@ -228,6 +238,7 @@ void ctoy_begin(void)
 		};
 		Gradient_PushColorArray(&cold_to_warm_gradient, cold2warm,8 );
 	}
+	background_cache = GradientBackground_CreateEmpty();
 
 
 	// Create flake meshes
@@ -236,6 +247,7 @@ void ctoy_begin(void)
 	flake = KochFlake_CreateDefault(4);
 	flake_mesh_recursion4 = Mesh_CreateEmpty();
 	KochFlake_WriteToMesh(&flake, &flake_mesh_recursion4);
+	KochMeshCache_Init(&flake_mesh_cache);
 
 	// Stanford bunny
 	//bunny_mesh = Bunny_Load_RAT("assets/bunny_medium.glb");
@@ -249,9 +261,10 @@ void ctoy_begin(void)
 
 	// Gosper curve
 	gosper_list = PointList_create(1200);
+	gosper_curve = GosperCurve_CreateEmpty();
 	float2 gstart = {00.0f, 00.0f};
 	float2 gdir = {0.0f, 1.0f};
-	Gosper_Create(&gosper_list, gstart, gdir, gosper_lenght, gosper_width, gosper_recursion);
+	GosperCurve_Build(&gosper_curve, gstart, gdir, gosper_lenght, gosper_recursion);
 
 	init_rocket_tracks();
 
@@ -274,6 +287,35 @@ void morph_flake(struct KochFlake* flake)
 	flake->angle = 60.0f + get_from_rocket(track_flake_angle_off);
 }
 
+/**
+ * @brief Mesh of the current flake parameters at a LOD level, regenerated only on a cache miss
+ */
+struct Mesh* get_flake_mesh(short level)
+{
+	flake.recursion_level = level;
+	return KochMeshCache_Get(&flake_mesh_cache, &flake);
+}
+
+// Generate the gosper curve as far as it is drawn,
+// and apply a new width only when the width track moves
+void update_gosper_curve()
+{
+	const int applied = gosper_list.used_size;
+	GosperCurve_Extend(&gosper_curve, get_from_rocket(track_gosper_segments));
+	if (!gosper_from_track || track_changed_since(track_gosper_width, gosper_row))
+	{
+		gosper_width = get_from_rocket(track_gosper_width) + 0.01f;
+		GosperCurve_ApplyWidth(&gosper_curve, gosper_width, &gosper_list, 0);
+		gosper_from_track = true;
+		gosper_row = current_rocket_row();
+	}
+	else if (gosper_curve.point_count > applied)
+	{
+		GosperCurve_ApplyWidth(&gosper_curve, gosper_width, &gosper_list, applied);
+	}
+	screenprintf("Gosper points %d", gosper_curve.point_count);
+}
+
 void fx_ears()
 {
 	// Ears
@@ -319,7 +361,7 @@ void fx_eva_bunny()
 		glTranslatef(center_x, center_y, 0.0f);
 		glScalef(1.0f, 1.0f, 1.0f);
 
-		GradientTexture_DrawGradient(grad, GradientCutout, gradient_size, offset);
+		GradientTexture_DrawBackground(&background_cache, grad, GradientCutout, gradient_size, offset, clear_color);
 
 		// Draw 2 bunnies overlaid with gradient
 		grad->shape = GradientVertical;
@@ -382,11 +424,7 @@ void fx_gradient_bunny()
 
 void fx_gosper_curve()
 {
-	// Regenerate
-	float2 gstart = {00.0f, 00.0f};
-	float2 gdir = {0.0f, 1.0f};
-	gosper_width = get_from_rocket(track_gosper_width) + 0.01f;
-	Gosper_Create(&gosper_list, gstart, gdir, gosper_lenght, gosper_width, gosper_recursion);
+	update_gosper_curve();
 	static float2 last_point;
 	short target_x = 0;
 	short x = get_from_rocket(track_translate_x);
@@ -421,9 +459,7 @@ void fx_hexa_gopher()
 {
 	start_frame_3D();
 	float2 gstart = {00.0f, 00.0f};
-	float2 gdir = {0.0f, 1.0f};
-	gosper_width = get_from_rocket(track_gosper_width) + 0.01f;
-	Gosper_Create(&gosper_list, gstart, gdir, gosper_lenght, gosper_width, gosper_recursion);
+	update_gosper_curve();
 	static float2 last_point;
 	float rotz = get_from_rocket(track_rotation_z);
 	float scale = get_from_rocket(track_scale_xyz);
@@ -433,6 +469,11 @@ void fx_hexa_gopher()
 	float2 corners[6];
 	get_corners(gstart, 6, 10.0f, 0.0f, corners);
 
+	// Same colors and points for every copy, only the matrix changes
+	static struct GosperStrip strip = {0};
+	last_point = GosperStrip_Prepare(&strip, &gosper_list, select_gradient(), get_from_rocket(track_gosper_segments),
+									 grad_offset, grad_step);
+
 
 	glPushMatrix();
 
@@ -447,8 +488,7 @@ void fx_hexa_gopher()
 
 				glTranslatef(corners[0].x, corners[0].y, 0.0f);
 				glRotatef(360.0f/6.0f * i, 1.0f, 0.0f, 1.0f);
-				last_point = Gosper_Draw(&gosper_list, select_gradient(), get_from_rocket(track_gosper_segments),
-										grad_offset, grad_step);
+				GosperStrip_Draw(&strip, &gosper_list);
 			glPopMatrix();
 		}
 	glPopMatrix();
@@ -657,9 +697,9 @@ void fx_stanford_bunny()
 			float grad_size = get_from_rocket(track_gradient_size);
 			glScalef(1.0f/grad_size * 2, 1.0/grad_size * 2, 1.0f);
 
-			GradientTexture_DrawGradient(bg_grad, GradientCutout,
-										 grad_size,
-					get_from_rocket(track_gradient_offset));
+			GradientTexture_DrawBackground(&background_cache, bg_grad, GradientCutout,
+										   grad_size,
+					get_from_rocket(track_gradient_offset), clear_color);
 
 		glPopMatrix();
 	}
@@ -710,14 +750,14 @@ void fx_flake_tunnel()
 	}
 
 	morph_flake(&flake);
-	flake.recursion_level = 4;
-	KochFlake_WriteToMesh(&flake, &flake_mesh_recursion4);
 	glDisable(GL_DEPTH_TEST);
 
 	glPushMatrix();
 	translate_by_rocket(0.0f, 0.0f);
 	rotate_by_rocket();
 	scale_by_rocket(false);
+	// Rotation around z keeps the size, each flake only adds its scale
+	float screen_radius = KochFlake_ProjectedRadius(flake.radius);
 
 
 	float2 center = {0.0f, 0.0f};
@@ -728,18 +768,45 @@ void fx_flake_tunnel()
 	float base_color = get_from_rocket(track_gradient_offset);
 	float scale_step = get_from_rocket(track_tunnel_scale_step) / 100.0f;
 	float rotation_step = get_from_rocket(track_tunnel_rotation_step);
+	if (shapes > TUNNEL_MAX_SHAPES)
+	{
+		shapes = TUNNEL_MAX_SHAPES;
+	}
 	screenprintf("Tunnel shapes %d", shapes);
+
+	// Consecutive flakes on the same LOD level go out as one draw.
+	// Levels only go down as the flakes shrink, so the drawing order stays.
+	float transforms[TUNNEL_MAX_SHAPES * 6];
+	color3 colors[TUNNEL_MAX_SHAPES];
+	float shape_stops[TUNNEL_MAX_SHAPES];
+	color3 shape_colors[TUNNEL_MAX_SHAPES];
 	for(int f = 0; f < shapes; f++)
 	{
-		Gradient_glColor(grad, base_color + gradient_step * f);
-		glPushMatrix();
-			glRotatef(rotation_step * f, 0.0f, 0.0f, 1.0f);
-			float flake_scale = scale - scale_step * (f+1);
-			screenprintf("Flake scale %d: %.2f", f, flake_scale);
-			glScalef(flake_scale, flake_scale, 1.0f);
-			Mesh_Draw(&flake_mesh_recursion4, DrawTriangles);
-		glPopMatrix();
+		shape_stops[f] = base_color + gradient_step * f;
 	}
+	Gradient_GetColors(grad, shape_stops, shapes, shape_colors);
+	int batch = 0;
+	short batch_level = 0;
+	for(int f = 0; f < shapes; f++)
+	{
+		float flake_scale = scale - scale_step * (f+1);
+		short level = KochFlake_SelectLOD(screen_radius * fabsf(flake_scale));
+		screenprintf("Flake scale %d: %.2f LOD %d", f, flake_scale, level);
+		if (batch > 0 && level != batch_level)
+		{
+			Mesh_DrawInstances(get_flake_mesh(batch_level), transforms, colors, batch);
+			batch = 0;
+		}
+		batch_level = level;
+		Mesh_SetTransform2D(&transforms[batch * 6], 0.0f, 0.0f, rotation_step * f, flake_scale);
+		colors[batch] = shape_colors[f];
+		batch++;
+	}
+	if (batch > 0)
+	{
+		Mesh_DrawInstances(get_flake_mesh(batch_level), transforms, colors, batch);
+	}
+	screenprintf("Flake mesh cache hit rate %.0f%%", KochMeshCache_HitRate(&flake_mesh_cache) * 100.0f);
 
 	glPopMatrix();
 
@@ -766,18 +833,19 @@ void fx_flake_wheel()
 {
 	start_frame_2D();
 	morph_flake(&flake);
-	flake.recursion_level = 4;
 	float old_radius = flake.radius;
 	float scale = get_from_rocket(track_scale_xyz);
-	flake.radius = scale;
-	KochFlake_WriteToMesh(&flake, &flake_mesh_recursion4);
-	flake.radius = old_radius;
 	glPushMatrix();
 		translate_by_rocket(center_x, center_y);
 		glRotatef( get_from_rocket(track_rotation_z), 0.0f, 0.0f, 1.0f );
 
+		flake.radius = scale;
+		struct Mesh* flake_mesh = get_flake_mesh(KochFlake_SelectLOD(KochFlake_ProjectedRadius(scale)));
+		flake.radius = old_radius;
+		screenprintf("Flake mesh cache hit rate %.0f%%", KochMeshCache_HitRate(&flake_mesh_cache) * 100.0f);
+
 		struct Gradient* grad = select_gradient();
-		flake_wheel_fx(&flake_mesh_recursion4,
+		flake_wheel_fx(flake_mesh,
 					get_from_rocket(track_flake_wheel_radius),
 					get_from_rocket(track_flake_wheel_outer_radius),
 					get_from_rocket(track_flake_wheel_shape_rotation),
@@ -797,6 +865,7 @@ void reset_flake_on_scene_change(int scene)
 	if (scene != prev_scene)
 	{
 		KochFlake_SetMorphToDefault(&flake);
+		flake.recursion_level = 4;
 		KochFlake_WriteToMesh(&flake, &flake_mesh_recursion4);
 		prev_scene = scene;
 	}
@@ -820,9 +889,9 @@ void fx_zen_ending()
 			float grad_size = get_from_rocket(track_gradient_size);
 			glScalef(1.0f/grad_size * 2, 1.0/grad_size * 2, 1.0f);
 
-			GradientTexture_DrawGradient(bg_grad, GradientCutout,
-										 grad_size,
-					get_from_rocket(track_gradient_offset));
+			GradientTexture_DrawBackground(&background_cache, bg_grad, GradientCutout,
+										   grad_size,
+					get_from_rocket(track_gradient_offset), clear_color);
 
 		glPopMatrix();
 	}
@@ -931,6 +1000,15 @@ void ctoy_main_loop(void)
 	screenprint("I am all ears");
 	screenprintf("Active scene %.0f", scene_number);
 	screenprintf("----------------", scene_number);
+#ifdef GEKKO
+	RocketFrameStats rocket_stats = get_rocket_frame_stats();
+	screenprintf("Rocket reads %d evals %d saved %d", rocket_stats.reads, rocket_stats.evaluations,
+				 rocket_stats.reads - rocket_stats.evaluations);
+#endif
+	// Counted during the previous frame
+	struct MeshDrawStats draw_stats = Mesh_TakeDrawStats();
+	screenprintf("Instanced draws %d saved %d", draw_stats.draw_calls, draw_stats.draw_calls_saved);
+	screenprintf("Background redraws %d reuses %d", background_cache.redraws, background_cache.reuses);
 
 	// Wii testing
 	/*
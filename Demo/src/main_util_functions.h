@@ -3,6 +3,8 @@
 
 // Hax to fix rotation illusion
 static float last_background_stop = -1.0f;
+// What clear_screen cleared to this frame
+static color3 clear_color;
 
 struct Gradient* select_gradient()
 {
@@ -97,13 +99,15 @@ void clear_screen( void )
 		if (bg_stop > 0.0f)
 		{
 			struct Gradient* activeGrad = select_gradient();
-			color3 bg = Gradient_GetColor(activeGrad, bg_stop);
-			glClearColor(bg.r, bg.g, bg.b, 0.0f);
+			clear_color = Gradient_GetColor(activeGrad, bg_stop);
 		}
 		else
 		{
-			glClearColor(0,0,0,0);
+			clear_color.r = 0.0f;
+			clear_color.g = 0.0f;
+			clear_color.b = 0.0f;
 		}
+		glClearColor(clear_color.r, clear_color.g, clear_color.b, 0.0f);
 		bg_stop = last_background_stop;
 
 	}
@@ -171,6 +175,25 @@ void start_frame_2D( void )
 	glTranslatef(0.375f, 0.375f, 0.0f);
 }
 
+// Change detection comes from the Wii rocket layer, elsewhere every track counts as changed
+bool track_changed_since(int track, double since_row)
+{
+#ifdef GEKKO
+	return rocket_changed_since(track, since_row);
+#else
+	return true;
+#endif
+}
+
+double current_rocket_row(void)
+{
+#ifdef GEKKO
+	return get_rocket_track_row();
+#else
+	return 0.0;
+#endif
+}
+
 void tri()
 {
 	glBegin(GL_TRIANGLES);
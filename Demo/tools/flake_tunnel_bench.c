@@ -0,0 +1,178 @@
+/* Draws and time per frame of the flake tunnel and the rotation illusion.
+ *
+ * usage: flake_tunnel_bench [-frames n] [-shapes n] [-scale s] [-step s] [-pixels radius]
+ *
+ * Runs the flake loop of fx_flake_tunnel at the LOD levels it selects: the
+ * flakes shrink by step from scale, a flake of scale 1 is pixels in radius
+ * on screen. Defaults are from the tunnel part of rocket.json. The meshes
+ * come from the KochMeshCache like in the demo. The flakes are drawn one
+ * Mesh_Draw per flake as before Mesh_DrawInstances and with the batches of
+ * the demo, then the six level 4 flakes of rotation_fx both ways.
+ */
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#define M_MATH_IMPLEMENTATION
+#include <m_math.h>
+#include <m_float2_math.c>
+#include <wii_memory_functions.c>
+#include "../src/Ziz/mesh.c"
+#include "../src/Fx/pointlist.c"
+#include "../src/Fx/koch_flake.c"
+#include "../src/Fx/color_manager.c"
+
+#define TUNNEL_MAX_SHAPES 32
+
+struct gl_host_stats {
+	long draws, vertices, matrix_ops;
+};
+extern struct gl_host_stats gl_host_stats;
+void glLoadIdentity(void);
+
+void screenprint_impl(const char *string) {}
+
+static struct KochMeshCache cache;
+static KochFlake flake;
+
+static double now_ns(void)
+{
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec * 1e9 + ts.tv_nsec;
+}
+
+static struct Mesh *flake_mesh(short level)
+{
+	flake.recursion_level = level;
+	return KochMeshCache_Get(&cache, &flake);
+}
+
+/* One copy at a time, like before Mesh_DrawInstances */
+static void draw_copies(struct Mesh *mesh, const float *transforms, const color3 *colors, int n)
+{
+	for (int i = 0; i < n; i++) {
+		const float *t = transforms + i * 6;
+		const float matrix[16] = {
+			t[0], t[1], 0.0f, 0.0f,
+			t[2], t[3], 0.0f, 0.0f,
+			0.0f, 0.0f, 1.0f, 0.0f,
+			t[4], t[5], 0.0f, 1.0f
+		};
+		glPushMatrix();
+		glMultMatrixf(matrix);
+		glColor3f(colors[i].r, colors[i].g, colors[i].b);
+		Mesh_Draw(mesh, DrawTriangles);
+		glPopMatrix();
+	}
+}
+
+typedef void (*draw_fn)(struct Mesh *, const float *, const color3 *, int);
+
+/* The flake loop of fx_flake_tunnel */
+static void tunnel(draw_fn draw, int shapes, float scale, float step, float pixels, float rotation,
+		   short *levels)
+{
+	float transforms[TUNNEL_MAX_SHAPES * 6];
+	color3 colors[TUNNEL_MAX_SHAPES];
+	int batch = 0;
+	short batch_level = 0;
+
+	for (int f = 0; f < shapes; f++) {
+		float flake_scale = scale - step * (f + 1);
+		short level = KochFlake_SelectLOD(pixels * fabsf(flake_scale));
+		color3 color = { 1.0f, f / (float)shapes, 0.5f };
+		if (levels)
+			levels[f] = level;
+		if (batch > 0 && level != batch_level) {
+			draw(flake_mesh(batch_level), transforms, colors, batch);
+			batch = 0;
+		}
+		batch_level = level;
+		Mesh_SetTransform2D(&transforms[batch * 6], 0.0f, 0.0f, rotation * f, flake_scale);
+		colors[batch] = color;
+		batch++;
+	}
+	if (batch > 0)
+		draw(flake_mesh(batch_level), transforms, colors, batch);
+}
+
+/* The first half of rotation_fx */
+static void rotation(draw_fn draw, float progress)
+{
+	float2 zero2 = { 0.0f, 0.0f };
+	float2 centers[6];
+	float transforms[6 * 6];
+	color3 colors[6];
+
+	get_corners(zero2, 6, 20.5f, progress * 30.0f, centers);
+	for (int i = 0; i < 6; i++) {
+		Mesh_SetTransform2D(&transforms[i * 6], centers[i].x, centers[i].y, progress * -30.0f, 20.5f);
+		colors[i].r = 0.8f;
+		colors[i].g = 0.2f;
+		colors[i].b = 0.35f;
+	}
+	draw(flake_mesh(4), transforms, colors, 6);
+}
+
+static void report(const char *name, draw_fn draw, int frames, bool is_tunnel, int shapes,
+		   float scale, float step, float pixels)
+{
+	struct MeshDrawStats mesh_stats;
+	double start, ns;
+
+	Mesh_TakeDrawStats();
+	memset(&gl_host_stats, 0, sizeof(gl_host_stats));
+	start = now_ns();
+	for (int f = 0; f < frames; ++f) {
+		glLoadIdentity();
+		if (is_tunnel)
+			tunnel(draw, shapes, scale, step, pixels, f * 0.5f, NULL);
+		else
+			rotation(draw, (f % 60) / 60.0f);
+	}
+	ns = (now_ns() - start) / frames;
+	mesh_stats = Mesh_TakeDrawStats();
+	printf("%-22s %8.0f ns/frame %6ld vertices %4ld draws %5ld matrix ops, saved %d\n", name, ns,
+	       gl_host_stats.vertices / frames, gl_host_stats.draws / frames,
+	       gl_host_stats.matrix_ops / frames, mesh_stats.draw_calls_saved / frames);
+}
+
+int main(int argc, char *argv[])
+{
+	int frames = 500, shapes = 8;
+	float scale = 2.5f, step = 0.3f, pixels = 120.0f;
+	short levels[TUNNEL_MAX_SHAPES];
+
+	for (int i = 1; i < argc; ++i) {
+		if (!strcmp(argv[i], "-frames") && i + 1 < argc)
+			frames = atoi(argv[++i]);
+		else if (!strcmp(argv[i], "-shapes") && i + 1 < argc)
+			shapes = atoi(argv[++i]);
+		else if (!strcmp(argv[i], "-scale") && i + 1 < argc)
+			scale = (float)atof(argv[++i]);
+		else if (!strcmp(argv[i], "-step") && i + 1 < argc)
+			step = (float)atof(argv[++i]);
+		else if (!strcmp(argv[i], "-pixels") && i + 1 < argc)
+			pixels = (float)atof(argv[++i]);
+	}
+	if (shapes > TUNNEL_MAX_SHAPES)
+		shapes = TUNNEL_MAX_SHAPES;
+
+	KochMeshCache_Init(&cache);
+	flake = KochFlake_CreateDefault(4);
+
+	tunnel(draw_copies, shapes, scale, step, pixels, 0.0f, levels);
+	printf("tunnel of %d flakes, LOD levels", shapes);
+	for (int f = 0; f < shapes; f++)
+		printf(" %d", levels[f]);
+	printf("\n");
+
+	report("tunnel, copies", draw_copies, frames, true, shapes, scale, step, pixels);
+	report("tunnel, instanced", Mesh_DrawInstances, frames, true, shapes, scale, step, pixels);
+	report("rotation, copies", draw_copies, frames, false, 0, 0.0f, 0.0f, 0.0f);
+	report("rotation, instanced", Mesh_DrawInstances, frames, false, 0, 0.0f, 0.0f, 0.0f);
+	return 0;
+}
@@ -0,0 +1,122 @@
+/* Before/after timing of the flake wheel submission on the host.
+ *
+ * usage: flake_wheel_bench [-frames n] [-level recursion]
+ *
+ * Runs the old flake_wheel_fx loop (get_corners per hexagon, a matrix
+ * push/translate/rotate/pop, gradient color and Mesh_Draw per flake) and the
+ * FlakeWheel_Build + Mesh_DrawInstances path over the same animated
+ * parameters. GL goes to gl_host.c, which does the CPU side of opengx.
+ */
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#define M_MATH_IMPLEMENTATION
+#include <m_math.h>
+#include <m_float2_math.c>
+#include <wii_memory_functions.c>
+#include "../src/Ziz/mesh.c"
+#include "../src/Fx/pointlist.c"
+#include "../src/Fx/koch_flake.c"
+#include "../src/Fx/color_manager.c"
+#include "../src/Fx/gradient.c"
+#include "../src/Fx/flake_wheel_fx.c"
+
+struct gl_host_stats {
+	long draws, vertices, matrix_ops;
+};
+extern struct gl_host_stats gl_host_stats;
+void glLoadIdentity(void);
+
+static double now_ns(void)
+{
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec * 1e9 + ts.tv_nsec;
+}
+
+/* flake_wheel_fx as it was before FlakeWheel_Build */
+static void flake_wheel_reference(struct Mesh *flake, float pattern_radius,
+				  float pattern_radius_outer, float shape_rotation_deg,
+				  float pattern_rotation_deg, float pattern_rotation_deg_outer,
+				  struct Gradient *gradient, float base_color_stop,
+				  float ring_color_offset, float shape_color_offset)
+{
+	float2 zero2 = { 0.0f, 0.0f };
+	float2 cornerlist[6];
+	get_corners(zero2, 6, pattern_radius, pattern_rotation_deg, cornerlist);
+	for (int i = 0; i < 6; i++) {
+		float2 hexpoints[6];
+		get_corners(cornerlist[i], 6, pattern_radius_outer, pattern_rotation_deg_outer, hexpoints);
+		for (int p = 0; p < 6; p++) {
+			glPushMatrix();
+			glTranslatef(hexpoints[p].x, hexpoints[p].y, 0.0f);
+			glRotatef(shape_rotation_deg, 0.0f, 0.0f, 1.0f);
+			Gradient_glColor(gradient, base_color_stop + ring_color_offset * i + shape_color_offset * p);
+			Mesh_Draw(flake, DrawTriangles);
+			glPopMatrix();
+		}
+	}
+}
+
+typedef void (*wheel_fn)(struct Mesh *, float, float, float, float, float,
+			 struct Gradient *, float, float, float);
+
+static double run(wheel_fn wheel, struct Mesh *mesh, struct Gradient *gradient,
+		  int frames, struct gl_host_stats *stats)
+{
+	double start;
+	memset(&gl_host_stats, 0, sizeof(gl_host_stats));
+	start = now_ns();
+	for (int f = 0; f < frames; ++f) {
+		float t = f / 60.0f;
+		glLoadIdentity();
+		wheel(mesh, 3.0f + sinf(t), 1.5f, t * 90.0f, t * 30.0f, t * -45.0f,
+		      gradient, t * 0.1f, 0.15f, 0.05f);
+	}
+	*stats = gl_host_stats;
+	return (now_ns() - start) / frames;
+}
+
+int main(int argc, char *argv[])
+{
+	int frames = 2000;
+	short level = 4;
+	color3 palette[3] = { { 1.0f, 0.2f, 0.3f }, { 0.2f, 0.4f, 1.0f }, { 1.0f, 1.0f, 0.6f } };
+	struct Gradient gradient = Gradient_CreateEmpty(GradientVertical, GradientLoopMirror);
+	struct gl_host_stats before, after;
+	double before_ns, after_ns;
+
+	for (int i = 1; i < argc; ++i) {
+		if (!strcmp(argv[i], "-frames") && i + 1 < argc)
+			frames = atoi(argv[++i]);
+		else if (!strcmp(argv[i], "-level") && i + 1 < argc)
+			level = (short)atoi(argv[++i]);
+	}
+
+	Gradient_PushColor(&gradient, &palette[0], 0.0f);
+	Gradient_PushColor(&gradient, &palette[1], 0.5f);
+	Gradient_PushColor(&gradient, &palette[2], 1.0f);
+
+	KochFlake flake = KochFlake_CreateDefault(level);
+	flake.recursion_level = level;
+	struct Mesh mesh = Mesh_CreateEmpty();
+	mesh.allocated_vertex_count = 0;
+	KochFlake_WriteToMesh(&flake, &mesh);
+
+	/* warm up the instance buffers */
+	run(flake_wheel_fx, &mesh, &gradient, 1, &after);
+
+	before_ns = run(flake_wheel_reference, &mesh, &gradient, frames, &before);
+	after_ns = run(flake_wheel_fx, &mesh, &gradient, frames, &after);
+
+	printf("flake wheel, %d shapes of %d vertices, %d frames\n",
+	       FLAKE_WHEEL_SHAPES, mesh.vertex_count, frames);
+	printf("before: %8.0f ns/frame, %ld draws, %ld matrix ops per frame\n",
+	       before_ns, before.draws / frames, before.matrix_ops / frames);
+	printf("after:  %8.0f ns/frame, %ld draws, %ld matrix ops per frame\n",
+	       after_ns, after.draws / frames, after.matrix_ops / frames);
+	return 0;
+}
@@ -0,0 +1,312 @@
+/* Software stand-in for the fixed function GL the effects call, for host
+ * benches that run the effect code without a GL context.
+ *
+ * Keeps the matrix stacks and does the CPU side work opengx does on the
+ * Wii: a draw loads the current matrix and writes every vertex (position
+ * and color) into the FIFO. Nothing is rasterized.
+ */
+#include <math.h>
+#include <string.h>
+#include <GL/gl.h>
+
+#define STACK_DEPTH 32
+
+struct gl_host_stats {
+	long draws, vertices, matrix_ops;
+};
+
+struct gl_host_stats gl_host_stats;
+
+/* Modelview and projection stacks */
+static float stack[2][STACK_DEPTH][16];
+static int top[2];
+static int mode;
+static float color[3] = { 1.0f, 1.0f, 1.0f };
+
+static struct {
+	int enabled, size;
+	GLenum type;
+	const void *data;
+} vertex_array, color_array;
+
+/* Write combined FIFO of the Wii, only the last words survive */
+static volatile float fifo[64];
+static unsigned fifo_pos;
+
+static void fifo_write(float v)
+{
+	fifo[fifo_pos++ & 63] = v;
+}
+
+static void mult(const float *m)
+{
+	float r[16], *c = stack[mode][top[mode]];
+	for (int i = 0; i < 4; ++i)
+		for (int j = 0; j < 4; ++j)
+			r[j * 4 + i] = c[i] * m[j * 4] + c[4 + i] * m[j * 4 + 1] +
+				       c[8 + i] * m[j * 4 + 2] + c[12 + i] * m[j * 4 + 3];
+	memcpy(c, r, sizeof(r));
+	gl_host_stats.matrix_ops++;
+}
+
+void glLoadIdentity(void)
+{
+	float *m = stack[mode][top[mode]];
+	memset(m, 0, sizeof(float) * 16);
+	m[0] = m[5] = m[10] = m[15] = 1.0f;
+}
+
+void glPushMatrix(void)
+{
+	if (top[mode] + 1 < STACK_DEPTH) {
+		memcpy(stack[mode][top[mode] + 1], stack[mode][top[mode]], sizeof(float) * 16);
+		top[mode]++;
+	}
+	gl_host_stats.matrix_ops++;
+}
+
+void glPopMatrix(void)
+{
+	if (top[mode] > 0)
+		top[mode]--;
+	gl_host_stats.matrix_ops++;
+}
+
+void glTranslatef(GLfloat x, GLfloat y, GLfloat z)
+{
+	float m[16] = { 1, 0, 0, 0, 0, 1, 0, 0, 0, 0, 1, 0, x, y, z, 1 };
+	mult(m);
+}
+
+void glScalef(GLfloat x, GLfloat y, GLfloat z)
+{
+	float m[16] = { x, 0, 0, 0, 0, y, 0, 0, 0, 0, z, 0, 0, 0, 0, 1 };
+	mult(m);
+}
+
+void glMultMatrixf(const GLfloat *m)
+{
+	mult(m);
+}
+
+/* Only the z axis rotations of the 2D effects */
+void glRotatef(GLfloat angle, GLfloat x, GLfloat y, GLfloat z)
+{
+	float r = angle * (float)M_PI / 180.0f, c = cosf(r), s = sinf(r);
+	float m[16] = { c, s, 0, 0, -s, c, 0, 0, 0, 0, 1, 0, 0, 0, 0, 1 };
+	mult(m);
+}
+
+void glColor3f(GLfloat r, GLfloat g, GLfloat b)
+{
+	color[0] = r;
+	color[1] = g;
+	color[2] = b;
+}
+
+void glColor4f(GLfloat r, GLfloat g, GLfloat b, GLfloat a)
+{
+	glColor3f(r, g, b);
+}
+
+void glMatrixMode(GLenum matrix_mode)
+{
+	mode = matrix_mode == GL_PROJECTION;
+}
+
+void glOrtho(GLdouble left, GLdouble right, GLdouble bottom, GLdouble top,
+	     GLdouble near_val, GLdouble far_val)
+{
+	float m[16] = { 0 };
+	m[0] = (float)(2.0 / (right - left));
+	m[5] = (float)(2.0 / (top - bottom));
+	m[10] = (float)(-2.0 / (far_val - near_val));
+	m[12] = (float)(-(right + left) / (right - left));
+	m[13] = (float)(-(top + bottom) / (top - bottom));
+	m[14] = (float)(-(far_val + near_val) / (far_val - near_val));
+	m[15] = 1.0f;
+	mult(m);
+}
+
+void glGetFloatv(GLenum pname, GLfloat *params)
+{
+	int m = pname == GL_PROJECTION_MATRIX;
+	memcpy(params, stack[m][top[m]], sizeof(float) * 16);
+}
+
+void glEnableClientState(GLenum array)
+{
+	if (array == GL_VERTEX_ARRAY)
+		vertex_array.enabled = 1;
+	else if (array == GL_COLOR_ARRAY)
+		color_array.enabled = 1;
+}
+
+void glDisableClientState(GLenum array)
+{
+	if (array == GL_VERTEX_ARRAY)
+		vertex_array.enabled = 0;
+	else if (array == GL_COLOR_ARRAY)
+		color_array.enabled = 0;
+}
+
+void glVertexPointer(GLint size, GLenum type, GLsizei stride, const GLvoid *pointer)
+{
+	vertex_array.size = size;
+	vertex_array.type = type;
+	vertex_array.data = pointer;
+}
+
+void glColorPointer(GLint size, GLenum type, GLsizei stride, const GLvoid *pointer)
+{
+	color_array.size = size;
+	color_array.type = type;
+	color_array.data = pointer;
+}
+
+void glNormalPointer(GLenum type, GLsizei stride, const GLvoid *pointer) {}
+void glTexCoordPointer(GLint size, GLenum type, GLsizei stride, const GLvoid *pointer) {}
+
+static void emit(int v)
+{
+	const float *p = (const float *)vertex_array.data + v * vertex_array.size;
+	for (int i = 0; i < vertex_array.size; ++i)
+		fifo_write(p[i]);
+	if (color_array.enabled && color_array.type == GL_UNSIGNED_BYTE) {
+		const unsigned char *c = (const unsigned char *)color_array.data + v * color_array.size;
+		unsigned int word;
+		memcpy(&word, c, sizeof(word));
+		fifo_write((float)word);
+	} else if (color_array.enabled) {
+		const float *c = (const float *)color_array.data + v * color_array.size;
+		for (int i = 0; i < color_array.size; ++i)
+			fifo_write(c[i]);
+	} else {
+		fifo_write(color[0]);
+		fifo_write(color[1]);
+		fifo_write(color[2]);
+	}
+}
+
+static void load_matrix(void)
+{
+	for (int i = 0; i < 12; ++i)
+		fifo_write(stack[0][top[0]][i]);
+	gl_host_stats.draws++;
+}
+
+void glDrawArrays(GLenum mode, GLint first, GLsizei count)
+{
+	load_matrix();
+	for (int v = first; v < first + count; ++v)
+		emit(v);
+	gl_host_stats.vertices += count;
+}
+
+void glDrawElements(GLenum mode, GLsizei count, GLenum type, const GLvoid *indices)
+{
+	const unsigned short *index = indices;
+	load_matrix();
+	for (int i = 0; i < count; ++i)
+		emit(index[i]);
+	gl_host_stats.vertices += count;
+}
+
+/* Immediate mode, every vertex carries the current color and texcoord */
+static float texcoord[2];
+
+void glBegin(GLenum mode)
+{
+	load_matrix();
+}
+
+void glEnd(void) {}
+
+void glTexCoord2f(GLfloat s, GLfloat t)
+{
+	texcoord[0] = s;
+	texcoord[1] = t;
+}
+
+void glVertex3f(GLfloat x, GLfloat y, GLfloat z)
+{
+	fifo_write(x);
+	fifo_write(y);
+	fifo_write(z);
+	fifo_write(color[0]);
+	fifo_write(color[1]);
+	fifo_write(color[2]);
+	fifo_write(texcoord[0]);
+	fifo_write(texcoord[1]);
+	gl_host_stats.vertices++;
+}
+
+void glVertex2f(GLfloat x, GLfloat y)
+{
+	glVertex3f(x, y, 0.0f);
+}
+
+/* Textures are accepted and dropped */
+static GLuint texture_names;
+
+void glGenTextures(GLsizei n, GLuint *textures)
+{
+	for (int i = 0; i < n; ++i)
+		textures[i] = ++texture_names;
+}
+
+void glDeleteTextures(GLsizei n, const GLuint *textures) {}
+
+void glBindTexture(GLenum target, GLuint texture) {}
+void glTexParameteri(GLenum target, GLenum pname, GLint param) {}
+void glTexImage2D(GLenum target, GLint level, GLint internalformat, GLsizei width, GLsizei height,
+		  GLint border, GLenum format, GLenum type, const GLvoid *pixels) {}
+/* Enabled state of the caps below 0x10000, enough for the fixed function ones */
+static unsigned char enabled[0x10000];
+
+void glEnable(GLenum cap)
+{
+	if (cap < sizeof(enabled))
+		enabled[cap] = 1;
+}
+
+void glDisable(GLenum cap)
+{
+	if (cap < sizeof(enabled))
+		enabled[cap] = 0;
+}
+
+GLboolean glIsEnabled(GLenum cap)
+{
+	return cap < sizeof(enabled) && enabled[cap];
+}
+
+/* Framebuffer copies, for the render to texture caches */
+long gl_host_copies;
+
+void glCopyTexSubImage2D(GLenum target, GLint level, GLint xoffset, GLint yoffset,
+			 GLint x, GLint y, GLsizei width, GLsizei height)
+{
+	gl_host_copies++;
+}
+void glBlendFunc(GLenum sfactor, GLenum dfactor) {}
+void glAlphaFunc(GLenum func, GLclampf ref) {}
+
+int gl_host_width = 640, gl_host_height = 480;
+
+int ctoy_frame_buffer_width(void)
+{
+	return gl_host_width;
+}
+
+int ctoy_frame_buffer_height(void)
+{
+	return gl_host_height;
+}
+
+void screenprintf_impl(const char *format, ...) {}
+
+/* ctoy's m_math, linked in but not called by the benches */
+void m_mat4_inverse(float *dest, const float *src) {}
+void m_mat4_transpose(float *dest, const float *src) {}
+void m_mat4_transform4(float *dest, const float *matrix, const float *src) {}
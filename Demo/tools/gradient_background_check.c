@@ -0,0 +1,141 @@
+/* Checks when the gradient background cache draws the gradient again.
+ *
+ * usage: gradient_background_check
+ *
+ * Runs GradientTexture_DrawBackground through the software GL of
+ * gl_host.c for frames that keep or change one part of the key: offset,
+ * size, shape, repeats, the gradient itself, its colors, the matrices and
+ * the clear color around it.
+ * Each frame must redraw and copy exactly when something changed, and
+ * reuse the texture otherwise, and leave the matrices and depth test as
+ * they were. Prints the vertices per frame of both.
+ */
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <m_math.h>
+#include <m_float2_math.c>
+#include "../src/Fx/color_manager.c"
+#include "../src/Fx/gradient.c"
+#include "../src/Fx/gradient_texture.c"
+
+struct gl_host_stats {
+	long draws, vertices, matrix_ops;
+};
+
+extern struct gl_host_stats gl_host_stats;
+extern long gl_host_copies;
+extern int gl_host_width, gl_host_height;
+
+int get_texture_width(int id)
+{
+	return 1;
+}
+
+int get_texture_height(int id)
+{
+	return 1;
+}
+
+void screenprint_impl(const char *string) {}
+
+static struct GradientBackground background;
+static int failures;
+static color3 clear_color;
+
+/* One frame like fx_stanford_bunny draws its background */
+static bool frame(struct Gradient *gradient, float size, float offset, float y)
+{
+	float before[16], after[16];
+	bool drawn;
+
+	glMatrixMode(GL_PROJECTION);
+	glLoadIdentity();
+	glOrtho(-4.0 / 3.0, 4.0 / 3.0, -1.0, 1.0, 0.1, 100.0);
+	glMatrixMode(GL_MODELVIEW);
+	glLoadIdentity();
+	glPushMatrix();
+	glTranslatef(0.0f, y, -90.0f);
+	glScalef(2.0f / size, 2.0f / size, 1.0f);
+	glEnable(GL_DEPTH_TEST);
+	glGetFloatv(GL_MODELVIEW_MATRIX, before);
+	drawn = GradientTexture_DrawBackground(&background, gradient, GradientCutout, size, offset, clear_color);
+	glGetFloatv(GL_MODELVIEW_MATRIX, after);
+	if (!glIsEnabled(GL_DEPTH_TEST) || memcmp(before, after, sizeof(before))) {
+		printf("state not restored\n");
+		failures++;
+	}
+	glPopMatrix();
+	return drawn;
+}
+
+static void expect(const char *name, bool drawn, bool expected)
+{
+	printf("%-28s %-8s %s\n", name, drawn ? "redraw" : "reuse", drawn == expected ? "ok" : "FAIL");
+	if (drawn != expected)
+		failures++;
+}
+
+int main(void)
+{
+	enum ColorName rainbow[] = { ColorRose, ColorDarkOrange, ColorOrange, ColorLightOrange,
+				     ColorOliveGreen, ColorGreen, ColorCyanBlue, ColorBlue, ColorPurple };
+	struct Gradient rainbow_gradient, white_gradient;
+	long copies, vertices;
+
+	ColorManager_LoadColors();
+	rainbow_gradient = Gradient_CreateEmpty(GradientCircle, GradientLoopRepeat);
+	Gradient_PushColorArray(&rainbow_gradient, rainbow, 9);
+	white_gradient = Gradient_CreateEmpty(GradientVertical, GradientLoopRepeat);
+	Gradient_PushName(&white_gradient, ColorWhite, 0.0f);
+	Gradient_PushName(&white_gradient, ColorWhite, 1.0f);
+	background = GradientBackground_CreateEmpty();
+
+	expect("first frame", frame(&rainbow_gradient, 300.0f, 0.5f, 0.0f), true);
+
+	copies = gl_host_copies;
+	vertices = gl_host_stats.vertices;
+	for (int i = 0; i < 10; i++)
+		expect("same key", frame(&rainbow_gradient, 300.0f, 0.5f, 0.0f), false);
+	if (gl_host_copies != copies) {
+		printf("copied while reusing\n");
+		failures++;
+	}
+	printf("reuse draws %.1f vertices per frame\n", (gl_host_stats.vertices - vertices) / 10.0);
+
+	expect("offset", frame(&rainbow_gradient, 300.0f, 0.6f, 0.0f), true);
+	expect("offset again", frame(&rainbow_gradient, 300.0f, 0.6f, 0.0f), false);
+	expect("size", frame(&rainbow_gradient, 200.0f, 0.6f, 0.0f), true);
+	rainbow_gradient.shape = GradientRadial;
+	expect("shape", frame(&rainbow_gradient, 200.0f, 0.6f, 0.0f), true);
+	rainbow_gradient.repeats = 2.0f;
+	expect("repeats", frame(&rainbow_gradient, 200.0f, 0.6f, 0.0f), true);
+	expect("matrix", frame(&rainbow_gradient, 200.0f, 0.6f, 0.2f), true);
+	clear_color.r = 0.5f;
+	expect("clear color", frame(&rainbow_gradient, 200.0f, 0.6f, 0.2f), true);
+	expect("clear color again", frame(&rainbow_gradient, 200.0f, 0.6f, 0.2f), false);
+	expect("other gradient", frame(&white_gradient, 200.0f, 0.6f, 0.2f), true);
+	expect("back to the first gradient", frame(&rainbow_gradient, 200.0f, 0.6f, 0.2f), true);
+	Gradient_PushName(&rainbow_gradient, ColorWhite, 0.95f);
+	expect("color pushed", frame(&rainbow_gradient, 200.0f, 0.6f, 0.2f), true);
+	Gradient_Invalidate(&rainbow_gradient);
+	expect("gradient invalidated", frame(&rainbow_gradient, 200.0f, 0.6f, 0.2f), true);
+	GradientBackground_Invalidate(&background);
+	expect("cache invalidated", frame(&rainbow_gradient, 200.0f, 0.6f, 0.2f), true);
+
+	vertices = gl_host_stats.vertices;
+	frame(&rainbow_gradient, 200.0f, 0.7f, 0.2f);
+	printf("redraw draws %ld vertices\n", gl_host_stats.vertices - vertices);
+
+	/* Too big for a texture: draws every frame */
+	gl_host_width = 1920;
+	gl_host_height = 1080;
+	expect("big screen", frame(&rainbow_gradient, 200.0f, 0.7f, 0.2f), true);
+	expect("big screen again", frame(&rainbow_gradient, 200.0f, 0.7f, 0.2f), true);
+
+	printf("%d redraws, %d reuses, %ld copies, %d failures\n",
+	       background.redraws, background.reuses, gl_host_copies, failures);
+	return failures ? 1 : 0;
+}
@@ -0,0 +1,147 @@
+/* Accuracy and speed of the gradient color tables against the stop search.
+ *
+ * usage: gradient_lut_check [-tolerance max_error]
+ *
+ * Builds the gradients of src/main.c, then compares Gradient_GetColor and
+ * Gradient_GetColors with Gradient_GetColorExact over stops from -4 to 4,
+ * for several repeats and both loop modes. Fails if any channel is off by
+ * more than the tolerance (default 8/255). Then checks that a copy of a
+ * baked gradient gets its own table and texture.
+ */
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include <m_math.h>
+#include "../src/Fx/color_manager.c"
+#include "../src/Fx/gradient.c"
+
+#define SAMPLES 100000
+
+static double now_ns(void)
+{
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec * 1e9 + ts.tv_nsec;
+}
+
+static float channel_error(color3 a, color3 b)
+{
+	return fmaxf(fabsf(a.r - b.r), fmaxf(fabsf(a.g - b.g), fabsf(a.b - b.b)));
+}
+
+int main(int argc, char *argv[])
+{
+	static struct Gradient gradients[5];
+	static const char *names[5] = { "rainbow", "white", "cold halo", "warm halo", "cold to warm" };
+	static float stops[SAMPLES];
+	static color3 batch[SAMPLES], exact[SAMPLES];
+	const float repeats[] = { 0.0f, 0.5f, 1.0f, 2.0f, 3.7f };
+	float tolerance = 8.0f / 255.0f, worst = 0.0f;
+	double exact_ns = 0.0, single_ns = 0.0, batch_ns = 0.0;
+
+	for (int i = 1; i < argc; ++i)
+		if (!strcmp(argv[i], "-tolerance") && i + 1 < argc)
+			tolerance = (float)atof(argv[++i]);
+
+	ColorManager_LoadColors();
+	{
+		enum ColorName rainbow[] = { ColorRose, ColorDarkOrange, ColorOrange, ColorLightOrange,
+					     ColorOliveGreen, ColorGreen, ColorCyanBlue, ColorBlue, ColorPurple };
+		gradients[0] = Gradient_CreateEmpty(GradientCircle, GradientLoopRepeat);
+		Gradient_PushColorArray(&gradients[0], rainbow, 9);
+	}
+	gradients[1] = Gradient_CreateEmpty(GradientVertical, GradientLoopRepeat);
+	Gradient_PushColor(&gradients[1], ColorManager_GetName(ColorWhite), 0.0f);
+	Gradient_PushColor(&gradients[1], ColorManager_GetName(ColorWhite), 1.0f);
+	gradients[2] = Gradient_CreateEmpty(GradientCircle, GradientLoopRepeat);
+	Gradient_PushName(&gradients[2], ColorBlackBlue, 0.0f);
+	Gradient_PushName(&gradients[2], ColorBlue, 0.40f);
+	Gradient_PushName(&gradients[2], ColorCyanBlue, 0.49f);
+	Gradient_PushName(&gradients[2], ColorWhite, 0.5f);
+	Gradient_PushName(&gradients[2], ColorCyanBlue, 0.51);
+	Gradient_PushName(&gradients[2], ColorBlue, 0.60f);
+	Gradient_PushName(&gradients[2], ColorBlackBlue, 1.0f);
+	gradients[3] = Gradient_CreateEmpty(GradientCircle, GradientLoopRepeat);
+	Gradient_PushName(&gradients[3], ColorDarkOrange, 0.0f);
+	Gradient_PushName(&gradients[3], ColorOrange, 0.40f);
+	Gradient_PushName(&gradients[3], ColorLightOrange, 0.45f);
+	Gradient_PushName(&gradients[3], ColorWhite, 0.5f);
+	Gradient_PushName(&gradients[3], ColorLightOrange, 0.55);
+	Gradient_PushName(&gradients[3], ColorOrange, 0.60f);
+	Gradient_PushName(&gradients[3], ColorDarkOrange, 1.0f);
+	{
+		enum ColorName cold2warm[] = { ColorRose, ColorDarkOrange, ColorOrange, ColorLightOrange,
+					       ColorGreen, ColorOliveGreen, ColorBlue, ColorCyanBlue };
+		gradients[4] = Gradient_CreateEmpty(GradientVertical, GradientLoopMirror);
+		Gradient_PushColorArray(&gradients[4], cold2warm, 8);
+	}
+
+	for (int i = 0; i < SAMPLES; ++i)
+		stops[i] = -4.0f + 8.0f * i / (SAMPLES - 1);
+
+	for (int g = 0; g < 5; ++g) {
+		struct Gradient *gradient = &gradients[g];
+		float gradient_worst = 0.0f;
+		for (int mode = 0; mode < 2; ++mode) {
+			gradient->loop_mode = mode == 0 ? GradientLoopRepeat : GradientLoopMirror;
+			for (size_t r = 0; r < sizeof(repeats) / sizeof(repeats[0]); ++r) {
+				double start;
+				gradient->repeats = repeats[r];
+
+				start = now_ns();
+				for (int i = 0; i < SAMPLES; ++i)
+					exact[i] = Gradient_GetColorExact(gradient, stops[i]);
+				exact_ns += now_ns() - start;
+
+				start = now_ns();
+				for (int i = 0; i < SAMPLES; ++i)
+					batch[i] = Gradient_GetColor(gradient, stops[i]);
+				single_ns += now_ns() - start;
+				for (int i = 0; i < SAMPLES; ++i)
+					gradient_worst = fmaxf(gradient_worst, channel_error(batch[i], exact[i]));
+
+				start = now_ns();
+				Gradient_GetColors(gradient, stops, SAMPLES, batch);
+				batch_ns += now_ns() - start;
+				for (int i = 0; i < SAMPLES; ++i)
+					gradient_worst = fmaxf(gradient_worst, channel_error(batch[i], exact[i]));
+			}
+		}
+		printf("%-13s max error %.5f (%.2f/255)\n", names[g], gradient_worst, gradient_worst * 255.0f);
+		worst = fmaxf(worst, gradient_worst);
+	}
+
+	{
+		double lookups = 5.0 * 2.0 * (sizeof(repeats) / sizeof(repeats[0])) * SAMPLES;
+		printf("ns per color: exact %.2f, table %.2f, batch %.2f\n",
+		       exact_ns / lookups, single_ns / lookups, batch_ns / lookups);
+	}
+	{
+		/* the copy changes its colors, the original must keep its own */
+		struct Gradient copy = gradients[2];
+		color3 before = Gradient_GetColor(&gradients[2], 0.3f);
+		Gradient_BindTexture(&gradients[2]);
+		Gradient_PushName(&copy, ColorRose, 0.3f);
+		Gradient_GetColor(&copy, 0.3f);
+		Gradient_BindTexture(&copy);
+		if (copy.lut == gradients[2].lut ||
+		    channel_error(before, Gradient_GetColor(&gradients[2], 0.3f)) > 0.0f) {
+			printf("FAIL: copy shares the table of the original\n");
+			worst = tolerance + 1.0f;
+		} else
+			printf("copy has its own table\n");
+		Gradient_Free(&copy);
+	}
+	for (int g = 0; g < 5; ++g)
+		Gradient_Free(&gradients[g]);
+
+	if (worst > tolerance) {
+		printf("FAIL: max error %.5f over tolerance %.5f\n", worst, tolerance);
+		return 1;
+	}
+	printf("OK\n");
+	return 0;
+}
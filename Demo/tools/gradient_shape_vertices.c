@@ -0,0 +1,97 @@
+/* Vertex count and CPU cost of the gradient shapes, textured against
+ * the per vertex colored tessellation.
+ *
+ * usage: gradient_shape_vertices [-frames n] [-size gradient_size]
+ *
+ * Draws each shape of GradientTexture_DrawGradient through the software GL
+ * of gl_host.c with the gradient texture on and off, in repeat and mirror
+ * mode and with the offsets moving like in the demo. Prints the vertices
+ * sent per draw and the time per draw.
+ */
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include <m_math.h>
+#include <m_float2_math.c>
+#include "../src/Fx/color_manager.c"
+#include "../src/Fx/gradient.c"
+#include "../src/Fx/gradient_texture.c"
+
+struct gl_host_stats {
+	long draws, vertices, matrix_ops;
+};
+
+extern struct gl_host_stats gl_host_stats;
+
+/* Not called by the shapes, only by GradientTexture_Create */
+int get_texture_width(int id)
+{
+	return 1;
+}
+
+int get_texture_height(int id)
+{
+	return 1;
+}
+
+void screenprint_impl(const char *string) {}
+
+static double now_ns(void)
+{
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec * 1e9 + ts.tv_nsec;
+}
+
+static void measure(struct Gradient *gradient, float size, int frames, bool textured,
+		    double *vertices, double *ns)
+{
+	double start;
+
+	GradientTexture_UseGradientTextures(textured);
+	memset(&gl_host_stats, 0, sizeof(gl_host_stats));
+	start = now_ns();
+	for (int f = 0; f < frames; ++f)
+		GradientTexture_DrawGradient(gradient, GradientMultiply, size, f * 0.013f - 2.0f);
+	*ns = (now_ns() - start) / frames;
+	*vertices = (double)gl_host_stats.vertices / frames;
+}
+
+int main(int argc, char *argv[])
+{
+	static const char *shapes[3] = { "vertical", "radial", "circle" };
+	static const char *modes[2] = { "repeat", "mirror" };
+	enum ColorName rainbow[] = { ColorRose, ColorDarkOrange, ColorOrange, ColorLightOrange,
+				     ColorOliveGreen, ColorGreen, ColorCyanBlue, ColorBlue, ColorPurple };
+	int frames = 2000;
+	float size = 300.0f;
+
+	for (int i = 1; i < argc; ++i) {
+		if (!strcmp(argv[i], "-frames") && i + 1 < argc)
+			frames = atoi(argv[++i]);
+		else if (!strcmp(argv[i], "-size") && i + 1 < argc)
+			size = (float)atof(argv[++i]);
+	}
+
+	ColorManager_LoadColors();
+	printf("%-9s %-7s %12s %12s %10s %10s\n", "shape", "loop", "vertices", "textured",
+	       "ns", "textured");
+	for (int shape = GradientVertical; shape <= GradientCircle; ++shape) {
+		for (int mode = 0; mode < 2; ++mode) {
+			struct Gradient gradient = Gradient_CreateEmpty(shape,
+				mode ? GradientLoopMirror : GradientLoopRepeat);
+			double colored_vertices, colored_ns, textured_vertices, textured_ns;
+
+			Gradient_PushColorArray(&gradient, rainbow, 9);
+			gradient.repeats = 2.0f;
+			measure(&gradient, size, frames, false, &colored_vertices, &colored_ns);
+			measure(&gradient, size, frames, true, &textured_vertices, &textured_ns);
+			printf("%-9s %-7s %12.1f %12.1f %10.0f %10.0f\n", shapes[shape], modes[mode],
+			       colored_vertices, textured_vertices, colored_ns, textured_ns);
+		}
+	}
+	return 0;
+}
@@ -0,0 +1,81 @@
+/* Vertex counts of the Koch flake levels before and after welding.
+ *
+ * usage: koch_weld_stats [-ratio r] [-extrusion e] [-angle degrees] [-frames n]
+ *
+ * Writes every LOD level of one morph (default the one of
+ * KochFlake_SetMorphToDefault) with KochFlake_WriteToMesh and
+ * KochFlake_WriteToMeshIndexed. Prints the vertices of each level, how many
+ * are left after welding and the time of both per call: the first indexed
+ * call runs the weld pass, later ones of a morph known to weld nothing skip it.
+ */
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#define M_MATH_IMPLEMENTATION
+#include <m_math.h>
+#include <m_float2_math.c>
+#include <wii_memory_functions.c>
+#include "../src/Ziz/mesh.c"
+#include "../src/Fx/pointlist.c"
+#include "../src/Fx/koch_flake.c"
+#include "../src/Fx/color_manager.c"
+
+void screenprint_impl(const char *string) {}
+
+static double now_ns(void)
+{
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec * 1e9 + ts.tv_nsec;
+}
+
+int main(int argc, char *argv[])
+{
+	KochFlake flake = KochFlake_CreateDefault(4);
+	struct Mesh mesh = Mesh_CreateEmpty();
+	int frames = 20;
+
+	for (int i = 1; i < argc; ++i) {
+		if (!strcmp(argv[i], "-ratio") && i + 1 < argc)
+			flake.ratio = (float)atof(argv[++i]);
+		else if (!strcmp(argv[i], "-extrusion") && i + 1 < argc)
+			flake.extrusion = (float)atof(argv[++i]);
+		else if (!strcmp(argv[i], "-angle") && i + 1 < argc)
+			flake.angle = (float)atof(argv[++i]);
+		else if (!strcmp(argv[i], "-frames") && i + 1 < argc)
+			frames = atoi(argv[++i]);
+	}
+
+	printf("ratio %.4f extrusion %.4f angle %.2f\n", flake.ratio, flake.extrusion, flake.angle);
+	printf("%5s %9s %9s %12s %12s %12s\n", "level", "vertices", "welded", "soup ns", "first ns", "again ns");
+	for (short level = 0; level <= KOCH_LOD_MAX_LEVEL; level++) {
+		double start, soup_ns, first_ns, again_ns;
+		int before;
+
+		flake.recursion_level = level;
+		start = now_ns();
+		for (int f = 0; f < frames; ++f)
+			KochFlake_WriteToMesh(&flake, &mesh);
+		soup_ns = (now_ns() - start) / frames;
+
+		/* as if the morph was new */
+		memset(weld_memo, 0, sizeof(weld_memo));
+		start = now_ns();
+		before = KochFlake_WriteToMeshIndexed(&flake, &mesh);
+		first_ns = now_ns() - start;
+
+		start = now_ns();
+		for (int f = 0; f < frames; ++f)
+			KochFlake_WriteToMeshIndexed(&flake, &mesh);
+		again_ns = (now_ns() - start) / frames;
+
+		printf("%5d %9d %9d %12.0f %12.0f %12.0f\n", level, before, mesh.vertex_count,
+		       soup_ns, first_ns, again_ns);
+	}
+	free(mesh.positions);
+	free(mesh.indices);
+	return 0;
+}
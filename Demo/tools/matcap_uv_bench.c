@@ -0,0 +1,253 @@
+/* Speed and accuracy of Mesh_GenerateMatcapUVs on the demo bunny.
+ *
+ * usage: matcap_uv_bench [-frames n] [-tolerance max_error] [-mesh file.glb]
+ *
+ * Loads the positions and normals of assets/bunny_medium.glb and runs the
+ * matcap UV generation as it was before the block kernel (4x4 transforms,
+ * inverse transpose, pow and sqrt per vertex) and Mesh_GenerateMatcapUVs
+ * under a few modelview matrices like rotate_by_rocket and
+ * scale_by_rocket give. Fails if any UV differs by more than the
+ * tolerance (default 1e-4), then prints the time per frame of both.
+ */
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#define CGLTF_IMPLEMENTATION
+#include <cgltf.h>
+#include <m_math.h>
+#include <m_float2_math.c>
+#include <wii_memory_functions.c>
+#include "../src/Fx/color_manager.c"
+#include "../src/Ziz/mesh.c"
+
+void glLoadIdentity(void);
+
+static double now_ns(void)
+{
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec * 1e9 + ts.tv_nsec;
+}
+
+/* Vertices of the first primitive, not indexed like load_to_mesh keeps them */
+static int load_mesh(const char *path, struct Mesh *mesh)
+{
+	cgltf_options options;
+	cgltf_data *data = NULL;
+	cgltf_primitive *primitive;
+	cgltf_accessor *positions = NULL, *normals = NULL;
+
+	memset(&options, 0, sizeof(options));
+	if (cgltf_parse_file(&options, path, &data) != cgltf_result_success ||
+	    cgltf_load_buffers(&options, data, path) != cgltf_result_success ||
+	    !data->meshes_count || !data->meshes[0].primitives_count)
+		return -1;
+	primitive = &data->meshes[0].primitives[0];
+	for (cgltf_size i = 0; i < primitive->attributes_count; ++i) {
+		if (primitive->attributes[i].type == cgltf_attribute_type_position)
+			positions = primitive->attributes[i].data;
+		else if (primitive->attributes[i].type == cgltf_attribute_type_normal)
+			normals = primitive->attributes[i].data;
+	}
+	if (!positions || !normals || positions->count != normals->count)
+		return -1;
+
+	*mesh = Mesh_CreateEmpty();
+	mesh->vertex_count = (int)positions->count;
+	Mesh_Allocate(mesh, mesh->vertex_count, AttributePosition | AttributeNormal | AttributeTexcoord);
+	cgltf_accessor_unpack_floats(positions, mesh->positions, positions->count * 3);
+	cgltf_accessor_unpack_floats(normals, mesh->normals, normals->count * 3);
+	cgltf_free(data);
+	return 0;
+}
+
+/* ctoy's m_mat4 functions, column major like GL */
+static void ref_transform4(float4 *dest, const float *m, const float4 *src)
+{
+	float4 r;
+	r.x = src->x * m[0] + src->y * m[4] + src->z * m[8] + src->w * m[12];
+	r.y = src->x * m[1] + src->y * m[5] + src->z * m[9] + src->w * m[13];
+	r.z = src->x * m[2] + src->y * m[6] + src->z * m[10] + src->w * m[14];
+	r.w = src->x * m[3] + src->y * m[7] + src->z * m[11] + src->w * m[15];
+	*dest = r;
+}
+
+static void ref_transpose(float *dest, const float *src)
+{
+	for (int i = 0; i < 4; ++i)
+		for (int j = 0; j < 4; ++j)
+			dest[i * 4 + j] = src[j * 4 + i];
+}
+
+static void ref_inverse(float *dest, const float *m)
+{
+	double inv[16], det;
+	inv[0] = m[5] * m[10] * m[15] - m[5] * m[11] * m[14] - m[9] * m[6] * m[15] + m[9] * m[7] * m[14] + m[13] * m[6] * m[11] - m[13] * m[7] * m[10];
+	inv[4] = -m[4] * m[10] * m[15] + m[4] * m[11] * m[14] + m[8] * m[6] * m[15] - m[8] * m[7] * m[14] - m[12] * m[6] * m[11] + m[12] * m[7] * m[10];
+	inv[8] = m[4] * m[9] * m[15] - m[4] * m[11] * m[13] - m[8] * m[5] * m[15] + m[8] * m[7] * m[13] + m[12] * m[5] * m[11] - m[12] * m[7] * m[9];
+	inv[12] = -m[4] * m[9] * m[14] + m[4] * m[10] * m[13] + m[8] * m[5] * m[14] - m[8] * m[6] * m[13] - m[12] * m[5] * m[10] + m[12] * m[6] * m[9];
+	inv[1] = -m[1] * m[10] * m[15] + m[1] * m[11] * m[14] + m[9] * m[2] * m[15] - m[9] * m[3] * m[14] - m[13] * m[2] * m[11] + m[13] * m[3] * m[10];
+	inv[5] = m[0] * m[10] * m[15] - m[0] * m[11] * m[14] - m[8] * m[2] * m[15] + m[8] * m[3] * m[14] + m[12] * m[2] * m[11] - m[12] * m[3] * m[10];
+	inv[9] = -m[0] * m[9] * m[15] + m[0] * m[11] * m[13] + m[8] * m[1] * m[15] - m[8] * m[3] * m[13] - m[12] * m[1] * m[11] + m[12] * m[3] * m[9];
+	inv[13] = m[0] * m[9] * m[14] - m[0] * m[10] * m[13] - m[8] * m[1] * m[14] + m[8] * m[2] * m[13] + m[12] * m[1] * m[10] - m[12] * m[2] * m[9];
+	inv[2] = m[1] * m[6] * m[15] - m[1] * m[7] * m[14] - m[5] * m[2] * m[15] + m[5] * m[3] * m[14] + m[13] * m[2] * m[7] - m[13] * m[3] * m[6];
+	inv[6] = -m[0] * m[6] * m[15] + m[0] * m[7] * m[14] + m[4] * m[2] * m[15] - m[4] * m[3] * m[14] - m[12] * m[2] * m[7] + m[12] * m[3] * m[6];
+	inv[10] = m[0] * m[5] * m[15] - m[0] * m[7] * m[13] - m[4] * m[1] * m[15] + m[4] * m[3] * m[13] + m[12] * m[1] * m[7] - m[12] * m[3] * m[5];
+	inv[14] = -m[0] * m[5] * m[14] + m[0] * m[6] * m[13] + m[4] * m[1] * m[14] - m[4] * m[2] * m[13] - m[12] * m[1] * m[6] + m[12] * m[2] * m[5];
+	inv[3] = -m[1] * m[6] * m[11] + m[1] * m[7] * m[10] + m[5] * m[2] * m[11] - m[5] * m[3] * m[10] - m[9] * m[2] * m[7] + m[9] * m[3] * m[6];
+	inv[7] = m[0] * m[6] * m[11] - m[0] * m[7] * m[10] - m[4] * m[2] * m[11] + m[4] * m[3] * m[10] + m[8] * m[2] * m[7] - m[8] * m[3] * m[6];
+	inv[11] = -m[0] * m[5] * m[11] + m[0] * m[7] * m[9] + m[4] * m[1] * m[11] - m[4] * m[3] * m[9] - m[8] * m[1] * m[7] + m[8] * m[3] * m[5];
+	inv[15] = m[0] * m[5] * m[10] - m[0] * m[6] * m[9] - m[4] * m[1] * m[10] + m[4] * m[2] * m[9] + m[8] * m[1] * m[6] - m[8] * m[2] * m[5];
+	det = m[0] * inv[0] + m[1] * inv[4] + m[2] * inv[8] + m[3] * inv[12];
+	det = 1.0 / det;
+	for (int i = 0; i < 16; ++i)
+		dest[i] = (float)(inv[i] * det);
+}
+
+/* Mesh_GenerateMatcapUVs before the block kernel */
+static void reference_matcap_uvs(const struct Mesh *mesh, const float *modelView, float *texcoords)
+{
+	float inverseView[16], normalMatrix[16];
+	const float2 half = { 0.5f, 0.5f };
+
+	ref_inverse(inverseView, modelView);
+	ref_transpose(normalMatrix, inverseView);
+	for (int i = 0; i < mesh->vertex_count; i++) {
+		float3 eye, normal, position, reflection;
+		float4 normal4, position4;
+		float2 R2, matcapUV;
+		int v = i * 3;
+
+		position.x = mesh->positions[v + 0];
+		position.y = mesh->positions[v + 1];
+		position.z = mesh->positions[v + 2];
+		normal4.x = mesh->normals[v + 0];
+		normal4.y = mesh->normals[v + 1];
+		normal4.z = mesh->normals[v + 2];
+		normal4.w = 0.0f;
+		position4.x = position.x;
+		position4.y = position.y;
+		position4.z = position.z;
+		position4.w = 1.0f;
+
+		ref_transform4(&position4, modelView, &position4);
+		position.x = position4.x;
+		position.y = position4.y;
+		position.z = position4.z;
+
+		matcapUV.x = 0.5f;
+		matcapUV.y = 0.5f;
+		if (M_LENGHT3(position) != 0.0f) {
+			M_NORMALIZE3(eye, position);
+			ref_transform4(&normal4, normalMatrix, &normal4);
+			normal.x = normal4.x;
+			normal.y = normal4.y;
+			normal.z = normal4.z;
+			M_NORMALIZE3(normal, normal);
+
+			float dot = M_DOT3(normal, eye);
+			reflection.x = eye.x - normal.x * dot * 2.0f;
+			reflection.y = eye.y - normal.y * dot * 2.0f;
+			reflection.z = eye.z - normal.z * dot * 2.0f;
+
+			const float rx2 = pow(reflection.x, 2.0f);
+			const float ry2 = pow(reflection.y, 2.0f);
+			const float rz12 = pow(reflection.z + 1, 2.0f);
+			const float sqrtR2 = sqrt(rx2 + ry2 + rz12) * 2.0f;
+			if (sqrtR2 != 0.0f) {
+				R2.x = reflection.x / sqrtR2;
+				R2.y = reflection.y / sqrtR2;
+				M_ADD2(matcapUV, R2, half);
+			}
+		}
+		texcoords[i * 2 + 0] = matcapUV.x;
+		texcoords[i * 2 + 1] = 1.0f - matcapUV.y;
+	}
+}
+
+/* translate, rotate around x then y, scale: the transforms of draw_matcap_bunny */
+static void make_modelview(float *m, float tz, float rx, float ry, float sx, float sy, float sz)
+{
+	float cx = cosf(rx), snx = sinf(rx), cy = cosf(ry), sny = sinf(ry);
+	float r[9] = { cy, snx * sny, -cx * sny, 0.0f, cx, snx, sny, -snx * cy, cx * cy };
+	memset(m, 0, sizeof(float) * 16);
+	for (int col = 0; col < 3; ++col)
+		for (int row = 0; row < 3; ++row)
+			m[col * 4 + row] = r[col * 3 + row] * (col == 0 ? sx : col == 1 ? sy : sz);
+	m[14] = tz;
+	m[15] = 1.0f;
+}
+
+int main(int argc, char *argv[])
+{
+	const char *path = "../assets/bunny_medium.glb";
+	const float poses[][6] = {
+		{ -3.0f, 0.0f, 0.0f, 1.0f, 1.0f, 1.0f },
+		{ -3.0f, 0.7f, 2.1f, 1.0f, 1.0f, 1.0f },
+		{ -5.0f, -1.3f, 0.4f, 2.5f, 2.5f, 2.5f },
+		{ -4.0f, 0.3f, -2.8f, 1.0f, 3.0f, 0.5f },
+		{ -2.0f, 2.0f, 1.0f, -1.0f, 1.0f, 1.0f },
+	};
+	const int pose_count = sizeof(poses) / sizeof(poses[0]);
+	struct Mesh mesh;
+	float *reference, modelview[16], tolerance = 1e-4f, worst = 0.0f;
+	double old_ns = 0.0, new_ns = 0.0, start;
+	int frames = 200;
+
+	for (int i = 1; i < argc; ++i) {
+		if (!strcmp(argv[i], "-frames") && i + 1 < argc)
+			frames = atoi(argv[++i]);
+		else if (!strcmp(argv[i], "-tolerance") && i + 1 < argc)
+			tolerance = (float)atof(argv[++i]);
+		else if (!strcmp(argv[i], "-mesh") && i + 1 < argc)
+			path = argv[++i];
+	}
+	if (load_mesh(path, &mesh)) {
+		fprintf(stderr, "cannot load %s\n", path);
+		return 1;
+	}
+	reference = malloc(sizeof(float) * 2 * mesh.vertex_count);
+
+	for (int p = 0; p < pose_count; ++p) {
+		const float *pose = poses[p];
+		float pose_error = 0.0f;
+
+		make_modelview(modelview, pose[0], pose[1], pose[2], pose[3], pose[4], pose[5]);
+		glLoadIdentity();
+		glMultMatrixf(modelview);
+
+		start = now_ns();
+		for (int f = 0; f < frames; ++f)
+			reference_matcap_uvs(&mesh, modelview, reference);
+		old_ns += now_ns() - start;
+
+		start = now_ns();
+		for (int f = 0; f < frames; ++f)
+			Mesh_GenerateMatcapUVs(&mesh);
+		new_ns += now_ns() - start;
+
+		for (int i = 0; i < mesh.vertex_count * 2; ++i)
+			pose_error = fmaxf(pose_error, fabsf(reference[i] - mesh.texcoords[i]));
+		printf("pose %d max uv error %.2e\n", p, pose_error);
+		worst = fmaxf(worst, pose_error);
+	}
+
+	printf("%d vertices, %s kernel\n", mesh.vertex_count,
+#ifdef MESH_USE_SSE
+	       "sse"
+#else
+	       "scalar"
+#endif
+	       );
+	printf("per frame: before %.1f us, blocks %.1f us (%.2f ns per vertex)\n",
+	       old_ns / (frames * pose_count) / 1e3, new_ns / (frames * pose_count) / 1e3,
+	       new_ns / ((double)frames * pose_count * mesh.vertex_count));
+	if (worst > tolerance) {
+		printf("FAIL: max error %.2e over tolerance %.2e\n", worst, tolerance);
+		return 1;
+	}
+	return 0;
+}
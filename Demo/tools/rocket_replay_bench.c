@@ -0,0 +1,142 @@
+/* Headless replay of the demo timeline through the rocket_ctoy layer.
+ *
+ * usage: rocket_replay_bench [-bake samples_per_row] [-dir track_dir]
+ *
+ * Loads the sync_*.track files of track_dir (default ..) through
+ * sync_create_device/sync_get_track with the tracks of init_rocket_tracks,
+ * then steps the whole timeline at 60 Hz like the Wii main loop does and
+ * reads every variable each frame. Prints the startup load time, ns per
+ * get_from_rocket and the rocket cost per frame. -bake 0 keeps every track
+ * on the exact evaluation. Values are compared with the exact evaluation of
+ * the player every frame: fails if (int) of a track with integer keys
+ * differs, the demo reads its selector tracks (scene, bunny_index,
+ * matcap_index...) that way.
+ */
+#include <stdio.h>
+#include <math.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "../rocket/sync.h"
+#include "../rocket/track.h"
+#include "../rocket/device.h"
+#include "../rocket/rocket_ctoy.h"
+
+#define FRAME_SECONDS (1.0 / 60.0)
+
+struct sync_device *initialize_rocket_device();
+
+// Timing of the demo, same as src/main.c
+static int track_row;
+static float row_rate;
+static float bpm = 144.0f;
+static float rpb = 4.0f;
+
+#include "../src/main_rocket.h"
+
+static const char *track_dir = "..";
+
+static double now_ns(void)
+{
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec * 1e9 + ts.tv_nsec;
+}
+
+/* The device looks in sourcefiles/, the tracks are checked in at the top */
+static void *open_track(const char *path, const char *mode)
+{
+	char temp[FILENAME_MAX];
+	const char *name = strrchr(path, '/');
+	snprintf(temp, sizeof(temp), "%s/%s", track_dir, name ? name + 1 : path);
+	return fopen(temp, mode);
+}
+
+int main(int argc, char *argv[])
+{
+	struct sync_io_cb io = {
+		open_track,
+		(size_t (*)(void *, size_t, size_t, void *))fread,
+		(int (*)(void *))fclose
+	};
+	struct sync_device *d;
+	int samples_per_row = ROCKET_BAKE_SAMPLES_PER_ROW;
+	static const struct sync_track *tracks[MAX_VARIABLES];
+	static float exact[MAX_VARIABLES];
+	static int cursors[MAX_VARIABLES];
+	int i, frames, last_row = 0, num_vars, int_mismatches = 0;
+	double start, load_ns, eval_ns = 0.0, read_ns = 0.0, sink = 0.0, max_error = 0.0;
+
+	for (i = 1; i < argc; ++i) {
+		if (!strcmp(argv[i], "-bake") && i + 1 < argc)
+			samples_per_row = atoi(argv[++i]);
+		else if (!strcmp(argv[i], "-dir") && i + 1 < argc)
+			track_dir = argv[++i];
+	}
+
+	start = now_ns();
+	d = initialize_rocket_device();
+	if (!d)
+		return 1;
+	sync_set_io_cb(d, &io);
+	init_rocket_tracks();
+	if (samples_per_row > 0)
+		rocket_bake_tracks(samples_per_row, ROCKET_BAKE_MAX_ERROR);
+	load_ns = now_ns() - start;
+
+	/* variables were added in the order the device created their tracks */
+	num_vars = (int)d->num_tracks;
+	for (i = 0; i < num_vars; ++i) {
+		const struct sync_track *t = d->tracks[i];
+		tracks[i] = t;
+		cursors[i] = -1;
+		if (t->num_keys && t->keys[t->num_keys - 1].row > last_row)
+			last_row = t->keys[t->num_keys - 1].row;
+	}
+	if (!last_row) {
+		fprintf(stderr, "no keys found in %s\n", track_dir);
+		return 1;
+	}
+	frames = (int)(last_row / row_rate / FRAME_SECONDS) + 1;
+
+	for (int f = 0; f < frames; ++f) {
+		set_rocket_track_seconds(f * FRAME_SECONDS);
+
+		start = now_ns();
+		rocket_evaluate_frame(get_rocket_track_row());
+		eval_ns += now_ns() - start;
+
+		start = now_ns();
+		for (i = 0; i < num_vars; ++i)
+			sink += get_from_rocket(i);
+		read_ns += now_ns() - start;
+
+		sync_get_vals_cursor(tracks, num_vars, get_rocket_track_row(), exact, cursors);
+		for (i = 0; i < num_vars; ++i) {
+			float value = get_from_rocket(i);
+			if (fabs(value - exact[i]) > max_error)
+				max_error = fabs(value - exact[i]);
+			/* the player evaluates in float and sync_get_val in double, reads
+			 * right at an integer may truncate either way and both are exact */
+			if (sync_track_is_integral(tracks[i]) && (int)value != (int)exact[i] &&
+			    (int)value != (int)(float)sync_get_val(tracks[i], get_rocket_track_row())) {
+				if (!int_mismatches)
+					printf("row %.2f %s: %f, exact %f\n", get_rocket_track_row(), tracks[i]->name,
+					       value, exact[i]);
+				int_mismatches++;
+			}
+		}
+	}
+
+	printf("%d tracks, %d rows, %d frames at %.1f bpm %.0f rpb, %s\n",
+	       num_vars, last_row, frames, bpm, rpb,
+	       samples_per_row > 0 ? "baked" : "exact");
+	printf("startup load %.2f ms\n", load_ns / 1e6);
+	printf("get_from_rocket %.2f ns\n", read_ns / ((double)frames * num_vars));
+	printf("per frame: evaluate %.0f ns, reads %.0f ns, total %.0f ns (checksum %g)\n",
+	       eval_ns / frames, read_ns / frames, (eval_ns + read_ns) / frames, sink);
+	printf("max error %.6f, %d reads with a different (int) than the exact value\n",
+	       max_error, int_mismatches);
+	return int_mismatches ? 1 : 0;
+}
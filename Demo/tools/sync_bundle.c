@@ -0,0 +1,210 @@
+/* Offline converter from .track files or rocket.json to a track bundle.
+ *
+ * usage: sync_bundle [-be] -o sync.rktb -json rocket.json
+ *        sync_bundle [-be] -o sync.rktb sync_row.track sync_scene.track ...
+ *
+ * -be writes the big-endian variant for the Wii.
+ * Copy the result to sourcefiles/<base>.rktb, sync_create_device picks it up
+ * in SYNC_PLAYER builds.
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "../rocket/sync.h"
+#include "../rocket/track.h"
+#include "../rocket/device.h"
+#include "../rocket/bundle.h"
+
+static int host_is_big_endian(void)
+{
+	const uint32_t one = 1;
+	return *(const unsigned char *)&one == 0;
+}
+
+/* sync_flake_ratio_off.track -> flake_ratio_off, undoing path_encode */
+static char *track_name_from_path(const char *path)
+{
+	const char *start = strrchr(path, '/');
+	const char *end;
+	char *name;
+	int len = 0;
+
+	start = start ? start + 1 : path;
+	if (strchr(start, '_'))
+		start = strchr(start, '_') + 1;
+	end = strstr(start, ".track");
+	if (!end)
+		end = start + strlen(start);
+
+	name = malloc(end - start + 1);
+	if (!name)
+		return NULL;
+
+	while (start < end) {
+		if (*start == '-' && end - start >= 3) {
+			char hex[3] = { start[1], start[2], '\0' };
+			name[len++] = (char)strtol(hex, NULL, 16);
+			start += 3;
+		} else {
+			name[len++] = *start++;
+		}
+	}
+	name[len] = '\0';
+	return name;
+}
+
+/* Same format as read_track_data in device.c */
+static struct sync_track *read_track_file(const char *path)
+{
+	struct sync_track *t;
+	int i;
+	FILE *fp = fopen(path, "rb");
+	if (!fp) {
+		fprintf(stderr, "could not open %s\n", path);
+		return NULL;
+	}
+
+	t = calloc(1, sizeof(*t));
+	t->name = track_name_from_path(path);
+	if (fread(&t->num_keys, sizeof(int), 1, fp) != 1 || t->num_keys < 0)
+		t->num_keys = 0;
+	t->keys = malloc(sizeof(struct track_key) * (t->num_keys ? t->num_keys : 1));
+
+	for (i = 0; i < t->num_keys; ++i) {
+		struct track_key *key = t->keys + i;
+		char type = 0;
+		fread(&key->row, sizeof(int), 1, fp);
+		fread(&key->value, sizeof(float), 1, fp);
+		fread(&type, sizeof(char), 1, fp);
+		key->type = (enum key_type)type;
+	}
+
+	fclose(fp);
+	return t;
+}
+
+static int write_bundle(struct sync_track *const *tracks, int num_tracks,
+    const char *path, int big_endian)
+{
+	struct sync_bundle_header h;
+	struct sync_bundle_track *index;
+	unsigned char *data;
+	uint32_t names_size = 0, num_keys = 0, key, name;
+	int i, j, swap;
+	FILE *fp;
+
+	for (i = 0; i < num_tracks; ++i) {
+		num_keys += tracks[i]->num_keys;
+		names_size += (uint32_t)strlen(tracks[i]->name) + 1;
+	}
+
+	memset(&h, 0, sizeof(h));
+	h.magic = SYNC_BUNDLE_MAGIC;
+	h.version = SYNC_BUNDLE_VERSION;
+	h.num_tracks = num_tracks;
+	h.num_keys = num_keys;
+	h.rows_offset = sync_bundle_align(sizeof(h) + num_tracks * sizeof(*index));
+	h.values_offset = sync_bundle_align(h.rows_offset + num_keys * 4);
+	h.types_offset = sync_bundle_align(h.values_offset + num_keys * 4);
+	h.names_offset = sync_bundle_align(h.types_offset + num_keys);
+	h.size = sync_bundle_align(h.names_offset + names_size);
+
+	data = calloc(1, h.size);
+	if (!data)
+		return -1;
+	index = (struct sync_bundle_track *)(data + sizeof(h));
+
+	key = 0;
+	name = 0;
+	for (i = 0; i < num_tracks; ++i) {
+		const struct sync_track *t = tracks[i];
+		index[i].name_offset = name;
+		index[i].first_key = key;
+		index[i].num_keys = t->num_keys;
+		strcpy((char *)data + h.names_offset + name, t->name);
+		name += (uint32_t)strlen(t->name) + 1;
+
+		for (j = 0; j < t->num_keys; ++j, ++key) {
+			int32_t row = t->keys[j].row;
+			memcpy(data + h.rows_offset + key * 4, &row, 4);
+			memcpy(data + h.values_offset + key * 4, &t->keys[j].value, 4);
+			data[h.types_offset + key] = (unsigned char)t->keys[j].type;
+		}
+	}
+	memcpy(data, &h, sizeof(h));
+
+	swap = big_endian != host_is_big_endian();
+	if (swap) {
+		uint32_t *words = (uint32_t *)data;
+		uint32_t count = (uint32_t)(sizeof(h) + num_tracks * sizeof(*index)) / 4;
+		for (key = 0; key < count; ++key)
+			words[key] = sync_bundle_swap32(words[key]);
+		words = (uint32_t *)(data + h.rows_offset);
+		for (key = 0; key < num_keys; ++key)
+			words[key] = sync_bundle_swap32(words[key]);
+		words = (uint32_t *)(data + h.values_offset);
+		for (key = 0; key < num_keys; ++key)
+			words[key] = sync_bundle_swap32(words[key]);
+	}
+
+	fp = fopen(path, "wb");
+	if (!fp) {
+		free(data);
+		return -1;
+	}
+	fwrite(data, 1, h.size, fp);
+	fclose(fp);
+	free(data);
+
+	printf("Wrote %d tracks, %u keys, %u bytes (%s-endian) to %s\n",
+	    num_tracks, num_keys, h.size, big_endian ? "big" : "little", path);
+	return 0;
+}
+
+int main(int argc, char *argv[])
+{
+	const char *out = NULL, *json = NULL;
+	struct sync_track **tracks = NULL;
+	struct sync_device *d = NULL;
+	int num_tracks = 0, big_endian = 0, result, i;
+
+	tracks = malloc(sizeof(*tracks) * (argc > 1 ? argc : 1));
+	for (i = 1; i < argc; ++i) {
+		if (!strcmp(argv[i], "-be"))
+			big_endian = 1;
+		else if (!strcmp(argv[i], "-o") && i + 1 < argc)
+			out = argv[++i];
+		else if (!strcmp(argv[i], "-json") && i + 1 < argc)
+			json = argv[++i];
+		else {
+			struct sync_track *t = read_track_file(argv[i]);
+			if (t)
+				tracks[num_tracks++] = t;
+		}
+	}
+
+	if (!out || (!json && !num_tracks)) {
+		fprintf(stderr, "usage: %s [-be] -o out" SYNC_BUNDLE_EXT
+		    " (-json rocket.json | file.track ...)\n", argv[0]);
+		return 1;
+	}
+
+	if (json) {
+		d = sync_create_device("sync");
+		if (!d || sync_load_json_tracks(d, json))
+			return 1;
+		result = write_bundle(d->tracks, (int)d->num_tracks, out, big_endian);
+		sync_destroy_device(d);
+	} else {
+		result = write_bundle(tracks, num_tracks, out, big_endian);
+	}
+
+	for (i = 0; i < num_tracks; ++i) {
+		free(tracks[i]->name);
+		free(tracks[i]->keys);
+		free(tracks[i]);
+	}
+	free(tracks);
+	return result ? 1 : 0;
+}
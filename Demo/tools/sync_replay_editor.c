@@ -0,0 +1,363 @@
+/* Loopback stand-in for the Rocket editor, measures the frame cost of
+ * sync_update while the editor streams key edits.
+ *
+ * usage: sync_replay_editor [-port n] [-frames n] [-burst keys] [-interval ms]
+ *                           [-record file] [-replay file] [rocket.json]
+ *
+ * The editor side serves the tracks of rocket.json on 127.0.0.1 and then
+ * sends a burst of SET_KEY/DELETE_KEY commands every interval, or replays a
+ * stream written earlier with -record. The demo side connects through
+ * sync_tcp_connect and runs a 60 Hz frame loop of sync_update and
+ * sync_get_val over all tracks, then prints the frame time distribution.
+ *
+ * Streams are records of big-endian u32 delay in ms, u32 length and the
+ * raw command bytes as the editor sends them after the track requests.
+ * Build with -DSYNC_NO_THREADS to compare against the polling sync_update.
+ */
+#include <netinet/in.h>
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/select.h>
+#include <sys/socket.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "../rocket/sync.h"
+#include "../rocket/track.h"
+#include "../rocket/device.h"
+
+#define FRAME_NS (1e9 / 60.0)
+#define ROW_RATE (125.0 / 60.0 * 8.0)
+
+struct editor {
+	int port, burst, interval_ms;
+	FILE *record, *replay;
+	struct sync_device *tracks; /* keys the editor serves and edits */
+	int *served;                /* demo track index -> editor track */
+	int num_served;
+	volatile int ready, stop;
+	long sent_bytes;
+};
+
+static double now_ns(void)
+{
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec * 1e9 + ts.tv_nsec;
+}
+
+static int recv_all(int sock, void *buf, int len)
+{
+	char *pos = buf;
+	while (len > 0) {
+		int n = (int)recv(sock, pos, len, 0);
+		if (n <= 0)
+			return -1;
+		pos += n;
+		len -= n;
+	}
+	return 0;
+}
+
+static void put_u32(unsigned char *buf, uint32_t v)
+{
+	v = htonl(v);
+	memcpy(buf, &v, sizeof(v));
+}
+
+static int put_set_key(unsigned char *buf, int track, const struct track_key *key)
+{
+	uint32_t value;
+	buf[0] = 0; /* SET_KEY */
+	put_u32(buf + 1, track);
+	put_u32(buf + 5, key->row);
+	memcpy(&value, &key->value, sizeof(value));
+	put_u32(buf + 9, value);
+	buf[13] = (unsigned char)key->type;
+	return 14;
+}
+
+static int put_del_key(unsigned char *buf, int track, int row)
+{
+	buf[0] = 1; /* DELETE_KEY */
+	put_u32(buf + 1, track);
+	put_u32(buf + 5, row);
+	return 9;
+}
+
+static int send_stream(struct editor *e, int sock, const unsigned char *buf, int len, int delay_ms)
+{
+	e->sent_bytes += len;
+	if (e->record) {
+		unsigned char head[8];
+		put_u32(head, delay_ms);
+		put_u32(head + 4, len);
+		fwrite(head, sizeof(head), 1, e->record);
+		fwrite(buf, len, 1, e->record);
+	}
+	return send(sock, buf, len, 0) == len ? 0 : -1;
+}
+
+/* GET_TRACK: reply with every key of the track, like the editor does */
+static int serve_track(struct editor *e, int sock)
+{
+	uint32_t len;
+	char name[256];
+	unsigned char *buf;
+	const struct sync_track *t;
+	int i, pos = 0, result;
+
+	if (recv_all(sock, &len, sizeof(len)))
+		return -1;
+	len = ntohl(len);
+	if (len >= sizeof(name) || recv_all(sock, name, len))
+		return -1;
+	name[len] = '\0';
+
+	e->served = realloc(e->served, sizeof(int) * (e->num_served + 1));
+	e->served[e->num_served] = -1;
+	for (i = 0; i < (int)e->tracks->num_tracks; ++i)
+		if (!strcmp(e->tracks->tracks[i]->name, name))
+			e->served[e->num_served] = i;
+	if (e->served[e->num_served++] < 0)
+		return 0;
+
+	t = e->tracks->tracks[e->served[e->num_served - 1]];
+	buf = malloc(14 * (t->num_keys + 1));
+	for (i = 0; i < t->num_keys; ++i)
+		pos += put_set_key(buf + pos, e->num_served - 1, t->keys + i);
+	result = pos ? (send(sock, buf, pos, 0) == pos ? 0 : -1) : 0;
+	free(buf);
+	return result;
+}
+
+/* Insert a key into each track in turn and delete the one of the previous burst */
+static int send_burst(struct editor *e, int sock, int delay_ms)
+{
+	static int burst_no;
+	unsigned char *buf = malloc(23 * e->burst);
+	int i, pos = 0, result;
+
+	for (i = 0; i < e->burst && e->num_served; ++i) {
+		int track = i % e->num_served;
+		struct track_key key;
+		key.row = 100000 + burst_no * e->burst + i;
+		key.value = (float)i;
+		key.type = KEY_LINEAR;
+		pos += put_set_key(buf + pos, track, &key);
+		if (burst_no > 0)
+			pos += put_del_key(buf + pos, track, key.row - e->burst);
+	}
+	burst_no++;
+	result = send_stream(e, sock, buf, pos, delay_ms);
+	free(buf);
+	return result;
+}
+
+static int replay_record(struct editor *e, int sock, double *next_ns)
+{
+	unsigned char head[8], *buf;
+	uint32_t delay, len;
+	int result;
+
+	if (fread(head, sizeof(head), 1, e->replay) != 1)
+		return 1;
+	memcpy(&delay, head, 4);
+	memcpy(&len, head + 4, 4);
+	buf = malloc(ntohl(len));
+	if (fread(buf, ntohl(len), 1, e->replay) != 1) {
+		free(buf);
+		return 1;
+	}
+	result = send(sock, buf, ntohl(len), 0) == (int)ntohl(len) ? 0 : -1;
+	*next_ns = now_ns() + ntohl(delay) * 1e6;
+	e->sent_bytes += ntohl(len);
+	free(buf);
+	return result;
+}
+
+static void *editor_main(void *arg)
+{
+	struct editor *e = arg;
+	struct sockaddr_in addr;
+	char greet[19];
+	int yes = 1, server, sock;
+	double next_ns = 0.0;
+
+	server = socket(AF_INET, SOCK_STREAM, 0);
+	setsockopt(server, SOL_SOCKET, SO_REUSEADDR, &yes, sizeof(yes));
+	memset(&addr, 0, sizeof(addr));
+	addr.sin_family = AF_INET;
+	addr.sin_port = htons(e->port);
+	addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+	if (bind(server, (struct sockaddr *)&addr, sizeof(addr)) || listen(server, 1)) {
+		perror("editor");
+		e->ready = -1;
+		return NULL;
+	}
+	e->ready = 1;
+
+	sock = accept(server, NULL, NULL);
+	if (sock < 0 || recv_all(sock, greet, sizeof(greet)) ||
+	    send(sock, "hello, demo!", 12, 0) != 12) {
+		close(server);
+		return NULL;
+	}
+
+	while (!e->stop) {
+		struct timeval to = { 0, 1000 };
+		fd_set rfds;
+		FD_ZERO(&rfds);
+		FD_SET(sock, &rfds);
+
+		if (select(sock + 1, &rfds, NULL, NULL, &to) > 0) {
+			unsigned char cmd, payload[4];
+			if (recv_all(sock, &cmd, 1))
+				break;
+			if (cmd == 2) {
+				if (serve_track(e, sock))
+					break;
+				next_ns = now_ns() + 1e9; /* let the demo settle first */
+			} else if (cmd == 3) {
+				if (recv_all(sock, payload, 4))
+					break;
+			} else
+				break;
+			continue;
+		}
+
+		if (next_ns == 0.0 || now_ns() < next_ns)
+			continue;
+		if (e->replay) {
+			if (replay_record(e, sock, &next_ns))
+				next_ns = 1e30;
+		} else {
+			if (send_burst(e, sock, e->interval_ms))
+				break;
+			next_ns = now_ns() + e->interval_ms * 1e6;
+		}
+	}
+
+	close(sock);
+	close(server);
+	return NULL;
+}
+
+static int compare_double(const void *a, const void *b)
+{
+	double x = *(const double *)a, y = *(const double *)b;
+	return x < y ? -1 : x > y;
+}
+
+static int is_playing(void *param)
+{
+	return 1;
+}
+
+int main(int argc, char *argv[])
+{
+	const char *path = "../sourcefiles/rocket.json";
+	struct editor e;
+	struct sync_device *d;
+	struct sync_cb cb = { NULL, NULL, is_playing };
+	const struct sync_track **tracks;
+	pthread_t editor_thread;
+	double *frame_us, next, start, sink = 0.0;
+	int frames = 600, n, i, f;
+
+	memset(&e, 0, sizeof(e));
+	e.port = SYNC_DEFAULT_PORT + 1;
+	e.burst = 500;
+	e.interval_ms = 100;
+
+	for (i = 1; i < argc; ++i) {
+		if (!strcmp(argv[i], "-port") && i + 1 < argc)
+			e.port = atoi(argv[++i]);
+		else if (!strcmp(argv[i], "-frames") && i + 1 < argc)
+			frames = atoi(argv[++i]);
+		else if (!strcmp(argv[i], "-burst") && i + 1 < argc)
+			e.burst = atoi(argv[++i]);
+		else if (!strcmp(argv[i], "-interval") && i + 1 < argc)
+			e.interval_ms = atoi(argv[++i]);
+		else if (!strcmp(argv[i], "-record") && i + 1 < argc)
+			e.record = fopen(argv[++i], "wb");
+		else if (!strcmp(argv[i], "-replay") && i + 1 < argc) {
+			e.replay = fopen(argv[++i], "rb");
+			if (!e.replay) {
+				fprintf(stderr, "cannot open %s\n", argv[i]);
+				return 1;
+			}
+		} else
+			path = argv[i];
+	}
+
+	e.tracks = sync_create_device("editor");
+	if (!e.tracks || sync_load_json_tracks(e.tracks, path))
+		return 1;
+
+	pthread_create(&editor_thread, NULL, editor_main, &e);
+	while (!e.ready)
+		usleep(1000);
+	if (e.ready < 0)
+		return 1;
+
+	d = sync_create_device("sync");
+	if (!d || sync_tcp_connect(d, "127.0.0.1", (unsigned short)e.port)) {
+		fprintf(stderr, "connect failed\n");
+		return 1;
+	}
+
+	n = (int)e.tracks->num_tracks;
+	tracks = malloc(sizeof(*tracks) * n);
+	for (i = 0; i < n; ++i)
+		tracks[i] = sync_get_track(d, e.tracks->tracks[i]->name);
+
+	frame_us = malloc(sizeof(*frame_us) * frames);
+	next = now_ns();
+	for (f = 0; f < frames; ++f) {
+		double row = f * ROW_RATE / 60.0;
+		start = now_ns();
+		if (sync_update(d, (int)row, &cb, NULL)) {
+			fprintf(stderr, "connection lost at frame %d\n", f);
+			frames = f;
+			break;
+		}
+		for (i = 0; i < n; ++i)
+			sink += sync_get_val(tracks[i], row);
+		frame_us[f] = (now_ns() - start) / 1e3;
+
+		next += FRAME_NS;
+		while (now_ns() < next)
+			usleep(200);
+	}
+
+	e.stop = 1;
+	pthread_join(editor_thread, NULL);
+
+	if (frames > 0) {
+		double total = 0.0;
+		for (f = 0; f < frames; ++f)
+			total += frame_us[f];
+		qsort(frame_us, frames, sizeof(double), compare_double);
+		printf("%s sync_update, %d tracks, %ld command bytes streamed\n",
+#ifdef SYNC_NO_THREADS
+		       "polling",
+#else
+		       "threaded",
+#endif
+		       n, e.sent_bytes);
+		printf("frame us: mean %.1f  p50 %.1f  p99 %.1f  max %.1f  (%d frames, checksum %g)\n",
+		       total / frames, frame_us[frames / 2], frame_us[frames * 99 / 100],
+		       frame_us[frames - 1], frames, sink);
+	}
+
+	if (e.record)
+		fclose(e.record);
+	if (e.replay)
+		fclose(e.replay);
+	sync_destroy_device(d);
+	sync_destroy_device(e.tracks);
+	return 0;
+}
@@ -0,0 +1,108 @@
+/* Microbenchmark of the batched sync_get_vals against a sync_get_val loop.
+ *
+ * usage: sync_vals_bench [rocket.json]
+ *
+ * Evaluates every track of the file at each row step of the whole
+ * timeline and prints ns per track evaluation and the largest difference
+ * between the float batch and the double scalar path. The batch only
+ * interpolates with SSE or NEON, sync_vals_bench_scalar builds it without
+ * SSE like the Wii gets it.
+ */
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+
+#include "../rocket/sync.h"
+#include "../rocket/track.h"
+#include "../rocket/device.h"
+
+#define ROW_STEP 0.1
+#define REPEATS 20
+
+static double now_ns(void)
+{
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec * 1e9 + ts.tv_nsec;
+}
+
+int main(int argc, char *argv[])
+{
+	const char *path = argc > 1 ? argv[1] : "../sourcefiles/rocket.json";
+	struct sync_device *d = sync_create_device("sync");
+	const struct sync_track **tracks;
+	float *out;
+	int *cursors;
+	int n, i, rep, last_row = 0;
+	double row, start, scalar_ns, batch_ns, cursor_ns, max_diff = 0.0, sink = 0.0;
+	long evals = 0;
+
+	if (!d || sync_load_json_tracks(d, path))
+		return 1;
+
+	n = (int)d->num_tracks;
+	tracks = malloc(sizeof(*tracks) * n);
+	out = malloc(sizeof(*out) * n);
+	cursors = malloc(sizeof(*cursors) * n);
+	for (i = 0; i < n; ++i) {
+		tracks[i] = d->tracks[i];
+		cursors[i] = -1;
+		if (tracks[i]->num_keys && tracks[i]->keys[tracks[i]->num_keys - 1].row > last_row)
+			last_row = tracks[i]->keys[tracks[i]->num_keys - 1].row;
+	}
+
+	start = now_ns();
+	for (rep = 0; rep < REPEATS; ++rep)
+		for (row = 0.0; row < last_row; row += ROW_STEP)
+			for (i = 0; i < n; ++i) {
+				sink += sync_get_val(tracks[i], row);
+				evals++;
+			}
+	scalar_ns = now_ns() - start;
+
+	start = now_ns();
+	for (rep = 0; rep < REPEATS; ++rep)
+		for (row = 0.0; row < last_row; row += ROW_STEP) {
+			sync_get_vals(tracks, n, row, out);
+			sink += out[0];
+		}
+	batch_ns = now_ns() - start;
+
+	start = now_ns();
+	for (rep = 0; rep < REPEATS; ++rep)
+		for (row = 0.0; row < last_row; row += ROW_STEP) {
+			sync_get_vals_cursor(tracks, n, row, out, cursors);
+			sink += out[0];
+		}
+	cursor_ns = now_ns() - start;
+
+	for (row = 0.0; row < last_row; row += ROW_STEP) {
+		sync_get_vals(tracks, n, row, out);
+		for (i = 0; i < n; ++i) {
+			double diff = fabs(out[i] - sync_get_val(tracks[i], row));
+			if (diff > max_diff)
+				max_diff = diff;
+		}
+	}
+
+	printf("%d tracks, %d rows, %ld evaluations per variant, %s batch\n", n, last_row, evals,
+#if defined(__SSE__) || defined(_M_X64)
+	       "sse"
+#elif defined(__ARM_NEON)
+	       "neon"
+#else
+	       "scalar"
+#endif
+	       );
+	printf("sync_get_val loop     %7.2f ns/track\n", scalar_ns / evals);
+	printf("sync_get_vals         %7.2f ns/track\n", batch_ns / evals);
+	printf("sync_get_vals_cursor  %7.2f ns/track\n", cursor_ns / evals);
+	printf("max difference %g (checksum %g)\n", max_diff, sink);
+
+	free(tracks);
+	free(out);
+	free(cursors);
+	sync_destroy_device(d);
+	return 0;
+}